@@ -97,6 +97,9 @@ void setup() {
   
   Serial.println(F("connected!"));
   
+  //store the sync value in the first CALIBRATION_EEPROM_SIZE bytes of EEPROM and skip syncing on the next start.
+  //hold a strong gesture for two seconds right after the start to sync again.
+  MyoIMUGestureController::enableCalibration(0);
   MyoIMUGestureController::begin(bridge, updateControls, updateLockOutput);
 }
 
@@ -104,4 +107,6 @@ void loop() {
   
   //update the connection to MyoBridge
   bridge.update();
+  //send commands of the gesture controller
+  MyoIMUGestureController::update();
 }
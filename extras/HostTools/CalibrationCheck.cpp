@@ -0,0 +1,166 @@
+/**
+ * @file   CalibrationCheck.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Checks the calibration profiles of calibration.h against a simulated EEPROM.
+ *
+ * Stores, loads and clears profiles in the EEPROM replacement of compat/EEPROM.h and checks
+ * the rejection of implausible sync values, that no byte outside of the profile range is written,
+ * the reuse of the slot of an armband, full slots, damaged profiles (CRC) and forgotten keys.
+ * Build with -DCALIBRATION_EEPROM, add -DCALIBRATION_EEPROM_COMMIT to check the ESP8266/ESP32 path.
+ * Prints every check and returns 1 if one of them failed.
+ *
+ * Usage:
+ *   CalibrationCheck [--address 100]
+ */
+
+#include <EEPROM.h>
+#include <stddef.h>
+#include "calibration.h"
+
+#ifndef CALIBRATION_EEPROM
+#error "build with -DCALIBRATION_EEPROM"
+#endif
+
+/// keys of the simulated armbands, one more than there are slots
+const uint8_t keys[CALIBRATION_SLOTS + 1][CALIBRATION_KEY_SIZE] = {
+  {0xC1, 0x00, 0x00, 0x00, 0x00, 0x01},
+  {0xC1, 0x00, 0x00, 0x00, 0x00, 0x02},
+  {0xC1, 0x00, 0x00, 0x00, 0x00, 0x03},
+  {0xC1, 0x00, 0x00, 0x00, 0x00, 0x04},
+  {0xC1, 0x00, 0x00, 0x00, 0x00, 0x05},
+};
+
+int failures = 0;
+
+void check(bool condition, const char* name) {
+  printf("%-60s %s\n", name, condition ? "ok" : "FAILED");
+  if (!condition) failures++;
+}
+
+/// erase the simulated EEPROM and the counters
+void eraseEEPROM() {
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  EEPROM.writes = 0;
+  EEPROM.commits = 0;
+}
+
+/// were only the bytes of the profiles written?
+bool outsideUntouched(int address) {
+  for (int i = 0; i < HOST_EEPROM_SIZE; i++) {
+    bool inside = (i >= address) && (i < address + (int) CALIBRATION_EEPROM_SIZE);
+    if (!inside && (EEPROM.data[i] != 0xFF)) return false;
+  }
+  return true;
+}
+
+/// sync value stored for a key, -1 if there is none
+long loaded(int address, const uint8_t* key) {
+  long emgSync;
+  return loadCalibration(address, key, emgSync) ? emgSync : -1;
+}
+
+/// EEPROM address of the slot holding the key, -1 if there is none
+int slotOf(int address, const uint8_t* key) {
+  int found = -1;
+  for (int slot = 0; slot < CALIBRATION_SLOTS; slot++) {
+    CalibrationProfile profile;
+    int slot_address = address + slot * sizeof(CalibrationProfile);
+    EEPROM.get(slot_address, profile);
+    if ((profile.magic == CALIBRATION_MAGIC) && !memcmp(profile.key, key, CALIBRATION_KEY_SIZE)) {
+      //the same key in two slots is an error as well
+      found = (found < 0) ? slot_address : -2;
+    }
+  }
+  return found;
+}
+
+int main(int argc, char** argv) {
+  int address = 100;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--address")) address = atoi(argv[i + 1]);
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if ((address < 0) || (address + CALIBRATION_EEPROM_SIZE > HOST_EEPROM_SIZE)) {
+    fprintf(stderr, "address out of range\n");
+    return 1;
+  }
+
+  //empty EEPROM and implausible values
+  eraseEEPROM();
+  check(loaded(address, keys[0]) < 0, "erased EEPROM has no profile");
+  check(!saveCalibration(address, keys[0], CALIBRATION_MIN_SYNC - 1), "sync below CALIBRATION_MIN_SYNC is rejected");
+  check(!saveCalibration(address, keys[0], CALIBRATION_MAX_SYNC + 1), "sync above CALIBRATION_MAX_SYNC is rejected");
+  check(EEPROM.writes == 0, "rejected values are not written");
+
+  //store and load
+  check(saveCalibration(address, keys[0], 2900), "save");
+  check(loaded(address, keys[0]) == 2900, "load returns the saved value");
+  check(loaded(address, NULL) < 0, "default key does not match another key");
+  check(loaded(address + CALIBRATION_EEPROM_SIZE, keys[0]) < 0, "other address has no profile");
+  check(outsideUntouched(address), "no byte outside of the profile range is written");
+  check(saveCalibration(address, NULL, CALIBRATION_MIN_SYNC) && (loaded(address, NULL) == CALIBRATION_MIN_SYNC),
+        "default key, CALIBRATION_MIN_SYNC is stored");
+
+  //slot reuse
+  int slot = slotOf(address, keys[0]);
+  check(saveCalibration(address, keys[0], 3100) && (slotOf(address, keys[0]) == slot), "update reuses the slot");
+  check(loaded(address, keys[0]) == 3100, "load returns the updated value");
+  unsigned long writes = EEPROM.writes;
+  saveCalibration(address, keys[0], 3100);
+  check(EEPROM.writes == writes, "saving the same value writes nothing");
+
+  //all slots in use
+  eraseEEPROM();
+  bool all_saved = true;
+  for (int i = 0; i < CALIBRATION_SLOTS; i++) {
+    all_saved = all_saved && saveCalibration(address, keys[i], 1000 + i);
+  }
+  bool all_loaded = true;
+  for (int i = 0; i < CALIBRATION_SLOTS; i++) {
+    all_loaded = all_loaded && (loaded(address, keys[i]) == 1000 + i);
+  }
+  check(all_saved && all_loaded, "one profile per slot");
+  check(saveCalibration(address, keys[CALIBRATION_SLOTS], 2000) && (loaded(address, keys[CALIBRATION_SLOTS]) == 2000),
+        "full: the new armband replaces one profile");
+  int remaining = 0;
+  for (int i = 0; i < CALIBRATION_SLOTS; i++) {
+    if (loaded(address, keys[i]) == 1000 + i) remaining++;
+  }
+  check(remaining == CALIBRATION_SLOTS - 1, "full: all other profiles are kept");
+  check(outsideUntouched(address), "no byte outside of the profile range is written");
+
+  //damaged profile
+  eraseEEPROM();
+  saveCalibration(address, keys[0], 2900);
+  saveCalibration(address, keys[1], 3300);
+  slot = slotOf(address, keys[0]);
+  EEPROM.data[slot + offsetof(CalibrationProfile, emgSync)] ^= 0x04;
+  check(loaded(address, keys[0]) < 0, "profile with wrong CRC is ignored");
+  check(loaded(address, keys[1]) == 3300, "other profiles stay valid");
+  check(saveCalibration(address, keys[0], 2900) && (loaded(address, keys[0]) == 2900), "damaged profile is replaced");
+
+  //forgotten key
+  clearCalibration(address, keys[0]);
+  check(loaded(address, keys[0]) < 0, "cleared profile is not loaded");
+  check(loaded(address, keys[1]) == 3300, "clearing keeps the other profiles");
+  writes = EEPROM.writes;
+  clearCalibration(address, keys[0]);
+  clearCalibration(address, keys[CALIBRATION_SLOTS]);
+  check(EEPROM.writes == writes, "clearing a missing profile writes nothing");
+  check(saveCalibration(address, keys[2], 3500) && (slotOf(address, keys[2]) == slot), "cleared slot is reused");
+
+  #ifdef CALIBRATION_EEPROM_COMMIT
+  //4 saves and 1 clear since the last erase
+  check(EEPROM.commits == 5, "every write is committed");
+  #else
+  check(EEPROM.commits == 0, "no commit without flash emulation");
+  #endif
+
+  printf("%d failed\n", failures);
+  return failures ? 1 : 0;
+}
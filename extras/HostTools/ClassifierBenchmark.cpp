@@ -0,0 +1,110 @@
+/**
+ * @file   ClassifierBenchmark.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Compares the gesture throughput of processCacheData() and the batch classifier.
+ *
+ * Records --gestures random gestures with SessionSynth, classifies all of them --rounds times
+ * with processCacheData() and processCacheDataBatch() and checks that both give identical results.
+ * Also reports the average and worst-case cost of processCacheData() per recognized gesture class,
+ * using the fastest of all rounds for every gesture to suppress scheduling noise.
+ * The batch path is only faster when built with -O3 -march=native -fno-math-errno -ffp-contract=off;
+ * with the -O2 of the other host tools it is slower than processCacheData() (about 0.9x).
+ *
+ * Usage:
+ *   ClassifierBenchmark [--gestures 4096] [--rounds 20] [--noise .01] [--seed 1]
+ */
+
+#include <vector>
+#include "sessionSynth.h"
+#include "gestureBatch.h"
+
+int main(int argc, char** argv) {
+  int num_gestures = 4096;
+  int rounds = 20;
+  uint32_t seed = 1;
+  SynthParams params = defaultSynthParams();
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--gestures")) num_gestures = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--rounds")) rounds = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--noise")) params.noise = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--seed")) seed = atoi(argv[i + 1]);
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  SessionSynth synth(0, seed, params);
+  std::vector<GestureCache> recorded(num_gestures);
+  std::vector<GestureType> expected(num_gestures);
+  for (int i = 0; i < num_gestures; i++) {
+    expected[i] = synth.recordGesture(recorded[i]);
+  }
+
+  //the classifiers reset the caches, so both work on copies
+  std::vector<GestureCache> caches(num_gestures);
+  std::vector<GestureType> scalar(num_gestures);
+  std::vector<GestureType> batch(num_gestures);
+
+  uint64_t scalar_ns = 0, batch_ns = 0;
+  for (int r = 0; r < rounds; r++) {
+    caches = recorded;
+    uint64_t start = hostTimeNs();
+    for (int i = 0; i < num_gestures; i++) {
+      scalar[i] = processCacheData(caches[i]);
+    }
+    scalar_ns += hostTimeNs() - start;
+
+    caches = recorded;
+    start = hostTimeNs();
+    processCacheDataBatch(caches.data(), num_gestures, batch.data());
+    batch_ns += hostTimeNs() - start;
+  }
+
+  //cost of single calls, per recognized class
+  std::vector<uint64_t> cost(num_gestures, ~0ULL);
+  for (int r = 0; r < rounds; r++) {
+    caches = recorded;
+    for (int i = 0; i < num_gestures; i++) {
+      uint64_t start = hostTimeNs();
+      processCacheData(caches[i]);
+      uint64_t duration = hostTimeNs() - start;
+      if (duration < cost[i]) cost[i] = duration;
+    }
+  }
+
+  uint64_t class_sum[ARM_UNKNOWN + 1] = {0};
+  uint64_t class_max[ARM_UNKNOWN + 1] = {0};
+  int class_count[ARM_UNKNOWN + 1] = {0};
+  for (int i = 0; i < num_gestures; i++) {
+    class_sum[scalar[i]] += cost[i];
+    class_count[scalar[i]]++;
+    if (cost[i] > class_max[scalar[i]]) class_max[scalar[i]] = cost[i];
+  }
+
+  printf("%-12s %8s %10s %10s\n", "class", "count", "avg ns", "max ns");
+  for (int c = 0; c <= ARM_UNKNOWN; c++) {
+    if (class_count[c] == 0) continue;
+    printf("%-12s %8d %10.0f %10llu\n", gestureToString((GestureType) c), class_count[c],
+           (double) class_sum[c] / class_count[c], (unsigned long long) class_max[c]);
+  }
+
+  int mismatches = 0, correct = 0;
+  for (int i = 0; i < num_gestures; i++) {
+    if (scalar[i] != batch[i]) mismatches++;
+    if (scalar[i] == expected[i]) correct++;
+  }
+
+  double total = (double) num_gestures * rounds;
+  printf("scalar: %.0f gestures/s\n", total / (scalar_ns / 1e9));
+#ifndef __NO_MATH_ERRNO__
+  printf("note: built without -fno-math-errno, the batch path is not vectorized\n");
+#endif
+  printf("batch:  %.0f gestures/s (%d lanes, %.2fx)\n", total / (batch_ns / 1e9), GESTURE_BATCH_LANES,
+         (double) scalar_ns / batch_ns);
+  printf("accuracy %.1f%%, %d of %d results differ between scalar and batch\n",
+         100. * correct / num_gestures, mismatches, num_gestures);
+  return mismatches ? 1 : 0;
+}
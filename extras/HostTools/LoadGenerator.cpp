@@ -0,0 +1,370 @@
+/**
+ * @file   LoadGenerator.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Puts GestureRecognizer under the load of many synthetic armbands and measures throughput, latency and accuracy.
+ *
+ * Generator threads synthesize the sessions of --devices armbands with SessionSynth (sync burst, lock/unlock poses and
+ * all gesture types with noise, speed and size variation) and hand the packets to worker threads through lock-free
+ * single producer, single consumer queues. Every worker owns the GestureRecognizer instances of its armbands
+ * (device % workers, as in MyoGateway). No sockets are involved, so the limits of the recognition itself are measured.
+ *
+ * --rate sets the packets per second of every armband; a real Myo sends 250 (50 IMU + 200 EMG), higher rates play the
+ * sessions faster. Packets that do not fit into a full queue are dropped and counted. With --rate 0, the generators
+ * produce as fast as the workers consume, which shows the maximum sustained throughput.
+ * The latency of a packet is measured from the time it was due according to the rate until the recognizer has
+ * processed it, so delays of the generator count as well. The recognizer gets the session timestamps, so the
+ * recognition does not depend on the load unless packets are dropped.
+ *
+ * Reports the offered and sustained packets per second, latency percentiles and the recognition accuracy per gesture type.
+ *
+ * Usage:
+ *   LoadGenerator [--devices 64] [--workers 4] [--generators 1] [--rate 250] [--duration 10] [--queue 4096]
+ *                 [--noise .01] [--speed-variation .2] [--idle 300] [--seed 1]
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "hostPacket.h"
+#include "sessionSynth.h"
+#include "gestureRecognizer.h"
+
+/// packets per second of a real armband
+#define LOAD_NOMINAL_RATE (1000 / SYNTH_IMU_PERIOD + 1000 / SYNTH_EMG_PERIOD)
+/// packets generated per armband in a row without rate limit, keeps the sessions of all armbands progressing
+#define LOAD_MAX_BURST 16
+/// sub-bins per power of two of the latency histogram, about 6% resolution
+#define LATENCY_SUB_BINS 16
+/// number of latency histogram bins, covers the full uint64_t range
+#define LATENCY_BINS (61 * LATENCY_SUB_BINS)
+
+/**
+ * Bounded single producer, single consumer packet queue.
+ */
+typedef struct PacketQueue {
+  std::vector<HostPacket> slots;
+  /// capacity - 1, the capacity is a power of two
+  uint64_t mask;
+  /// next packet to read, written by the worker
+  std::atomic<uint64_t> head;
+  /// keeps head and tail on different cache lines
+  char padding[64];
+  /// next free slot, written by the generator
+  std::atomic<uint64_t> tail;
+} PacketQueue;
+
+/// a recognized gesture
+typedef struct Recognition {
+  uint32_t timestamp;
+  GestureType gesture;
+} Recognition;
+
+/**
+ * One simulated armband. The synth is only used by its generator, the rest only by its worker
+ * until all threads are finished.
+ */
+typedef struct LoadDevice {
+  SessionSynth* synth;
+  /// timestamp of the first packet
+  uint32_t first;
+  /// queue to the worker of the armband
+  PacketQueue* queue;
+  GestureRecognizer recognizer;
+  std::vector<Recognition> recognitions;
+  /// timestamp of the last processed packet
+  uint32_t last;
+} LoadDevice;
+
+/**
+ * Results of one worker, merged after the run.
+ */
+typedef struct WorkerStats {
+  uint64_t packets;
+  /// packets processed before the end of the measurement
+  uint64_t packets_in_time;
+  uint64_t latency[LATENCY_BINS];
+  uint64_t latency_max;
+} WorkerStats;
+
+static std::vector<LoadDevice*> devices;
+static int num_workers = 4;
+static int num_generators = 1;
+/// time scale of the sessions, packets per second / LOAD_NOMINAL_RATE, 0 for no rate limit
+static double scale = 1.;
+static uint64_t start_ns = 0;
+static uint64_t end_ns = 0;
+static std::atomic<int> generators_running;
+static std::atomic<uint64_t> generated;
+static std::atomic<uint64_t> dropped;
+
+/// histogram bin of a latency: 16 bins per power of two
+static int latencyBin(uint64_t ns) {
+  if (ns < LATENCY_SUB_BINS) return ns;
+  int msb = 63 - __builtin_clzll(ns);
+  return (msb - 3) * LATENCY_SUB_BINS + ((ns >> (msb - 4)) & (LATENCY_SUB_BINS - 1));
+}
+
+/// upper bound of a latency histogram bin
+static uint64_t latencyBinLimit(int bin) {
+  if (bin < LATENCY_SUB_BINS) return bin;
+  int msb = bin / LATENCY_SUB_BINS + 3;
+  uint64_t sub = bin % LATENCY_SUB_BINS;
+  return ((LATENCY_SUB_BINS + sub + 1) << (msb - 4)) - 1;
+}
+
+/// host time at which a packet is due
+static uint64_t dueTime(LoadDevice* device, uint32_t timestamp) {
+  return start_ns + (uint64_t) ((timestamp - device->first) * 1e6 / scale);
+}
+
+/**
+ * Generates the packets of every num_generators-th armband, starting with index.
+ */
+static void runGenerator(int index) {
+  uint64_t count = 0, lost = 0;
+  HostPacket packet;
+
+  while (true) {
+    uint64_t now = hostTimeNs();
+    if (now >= end_ns) break;
+    uint64_t next_due = end_ns;
+    bool pushed = false;
+
+    for (size_t d = index; d < devices.size(); d += num_generators) {
+      LoadDevice* device = devices[d];
+      PacketQueue* queue = device->queue;
+
+      for (int burst = 0; (scale > 0.) || (burst < LOAD_MAX_BURST); burst++) {
+        uint64_t due = now;
+        if (scale > 0.) {
+          due = dueTime(device, device->synth->peekTime());
+          if (due > now) {
+            next_due = min(next_due, due);
+            break;
+          }
+        }
+
+        uint64_t tail = queue->tail.load(std::memory_order_relaxed);
+        bool full = (tail - queue->head.load(std::memory_order_acquire) > queue->mask);
+        if (full && (scale == 0.)) break;
+
+        if (full) {
+          //a real armband does not wait either
+          device->synth->next(packet);
+          lost++;
+          continue;
+        }
+
+        HostPacket &slot = queue->slots[tail & queue->mask];
+        device->synth->next(slot);
+        slot.sent_ns = due;
+        queue->tail.store(tail + 1, std::memory_order_release);
+        count++;
+        pushed = true;
+      }
+    }
+
+    if (scale > 0.) {
+      //sleep until the next packet is due
+      now = hostTimeNs();
+      if (next_due > now) {
+        struct timespec ts;
+        ts.tv_sec = (next_due - now) / 1000000000ULL;
+        ts.tv_nsec = (next_due - now) % 1000000000ULL;
+        nanosleep(&ts, NULL);
+      }
+    } else if (!pushed) {
+      std::this_thread::yield();
+    }
+  }
+
+  generated.fetch_add(count);
+  dropped.fetch_add(lost);
+  generators_running.fetch_sub(1);
+}
+
+/// run one packet through the recognizer of its device
+static void processPacket(HostPacket &packet, WorkerStats &stats) {
+  LoadDevice* device = devices[packet.device];
+  uint8_t events;
+  if (packet.type == HOST_PACKET_IMU) {
+    events = device->recognizer.handleIMUData(packet.imu, packet.timestamp);
+  } else {
+    events = device->recognizer.handleEMGData(packet.emg, packet.timestamp);
+  }
+  device->last = packet.timestamp;
+
+  if (events & RECOGNIZER_GESTURE) {
+    Recognition recognition;
+    recognition.timestamp = packet.timestamp;
+    recognition.gesture = device->recognizer.getGesture();
+    device->recognitions.push_back(recognition);
+  }
+
+  uint64_t now = hostTimeNs();
+  uint64_t latency = (now > packet.sent_ns) ? now - packet.sent_ns : 0;
+  stats.latency[latencyBin(latency)]++;
+  stats.latency_max = max(stats.latency_max, latency);
+  stats.packets++;
+  if (now < end_ns) stats.packets_in_time++;
+}
+
+/**
+ * Processes the queues of one worker (one per generator) until the generators are finished and the queues are empty.
+ */
+static void runWorker(std::vector<PacketQueue*>* queues, WorkerStats* stats) {
+  while (true) {
+    bool finished = (generators_running.load() == 0);
+    bool idle = true;
+
+    for (size_t q = 0; q < queues->size(); q++) {
+      PacketQueue* queue = (*queues)[q];
+      uint64_t head = queue->head.load(std::memory_order_relaxed);
+      uint64_t tail = queue->tail.load(std::memory_order_acquire);
+      for (; head != tail; head++) {
+        processPacket(queue->slots[head & queue->mask], *stats);
+      }
+      if (head != queue->head.load(std::memory_order_relaxed)) {
+        queue->head.store(head, std::memory_order_release);
+        idle = false;
+      }
+    }
+
+    //the queues were checked after the generators had stopped
+    if (idle && finished) break;
+    if (idle) std::this_thread::yield();
+  }
+}
+
+int main(int argc, char** argv) {
+  int num_devices = 64;
+  double rate = LOAD_NOMINAL_RATE;
+  double duration_s = 10.;
+  int queue_size = 4096;
+  uint32_t seed = 1;
+  SynthParams params = defaultSynthParams();
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--devices")) num_devices = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--workers")) num_workers = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--generators")) num_generators = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--rate")) rate = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--duration")) duration_s = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--queue")) queue_size = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--noise")) params.noise = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--speed-variation")) params.speed_variation = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--idle")) params.idle_time = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--seed")) seed = atoi(argv[i + 1]);
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if ((num_devices < 1) || (num_devices > 65536) || (num_workers < 1) || (num_generators < 1) || (queue_size < 1)) {
+    fprintf(stderr, "invalid number of devices, workers, generators or queue size\n");
+    return 1;
+  }
+  scale = rate / LOAD_NOMINAL_RATE;
+
+  //one queue per generator and worker
+  uint64_t capacity = 1;
+  while (capacity < (uint64_t) queue_size) capacity <<= 1;
+  std::vector<std::vector<PacketQueue*> > worker_queues(num_workers);
+  std::vector<PacketQueue*> queues(num_generators * num_workers);
+  for (int g = 0; g < num_generators; g++) {
+    for (int w = 0; w < num_workers; w++) {
+      PacketQueue* queue = new PacketQueue();
+      queue->slots.resize(capacity);
+      queue->mask = capacity - 1;
+      queue->head.store(0);
+      queue->tail.store(0);
+      queues[g * num_workers + w] = queue;
+      worker_queues[w].push_back(queue);
+    }
+  }
+
+  for (int i = 0; i < num_devices; i++) {
+    LoadDevice* device = new LoadDevice();
+    device->synth = new SessionSynth(i, seed * 7919 + i, params);
+    device->first = device->synth->peekTime();
+    device->queue = queues[(i % num_generators) * num_workers + i % num_workers];
+    device->last = device->first;
+    devices.push_back(device);
+  }
+
+  std::vector<WorkerStats> stats(num_workers);
+  memset(stats.data(), 0, stats.size() * sizeof(WorkerStats));
+  generators_running.store(num_generators);
+  generated.store(0);
+  dropped.store(0);
+  start_ns = hostTimeNs();
+  end_ns = start_ns + (uint64_t) (duration_s * 1e9);
+
+  std::vector<std::thread> threads;
+  for (int w = 0; w < num_workers; w++) threads.push_back(std::thread(runWorker, &worker_queues[w], &stats[w]));
+  for (int g = 0; g < num_generators; g++) threads.push_back(std::thread(runGenerator, g));
+  for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+
+  //merge the worker statistics
+  WorkerStats total;
+  memset(&total, 0, sizeof(total));
+  for (int w = 0; w < num_workers; w++) {
+    total.packets += stats[w].packets;
+    total.packets_in_time += stats[w].packets_in_time;
+    total.latency_max = max(total.latency_max, stats[w].latency_max);
+    for (int b = 0; b < LATENCY_BINS; b++) total.latency[b] += stats[w].latency[b];
+  }
+
+  uint64_t offered = generated.load() + dropped.load();
+  printf("devices %d, workers %d, generators %d, %.0f packets/s per device\n", num_devices, num_workers,
+         num_generators, rate);
+  printf("offered    %10.0f packets/s\n", offered / duration_s);
+  printf("sustained  %10.0f packets/s\n", total.packets_in_time / duration_s);
+  printf("dropped    %10llu packets (%.2f%%)\n", (unsigned long long) dropped.load(),
+         offered ? 100. * dropped.load() / offered : 0.);
+
+  const double percentiles[] = {.5, .9, .99, .999};
+  printf("latency us");
+  for (int p = 0; p < 4; p++) {
+    uint64_t count = 0;
+    int bin = 0;
+    while ((bin < LATENCY_BINS - 1) && (count + total.latency[bin] < percentiles[p] * total.packets)) {
+      count += total.latency[bin++];
+    }
+    printf("  p%g %.1f", percentiles[p] * 100., latencyBinLimit(bin) / 1e3);
+  }
+  printf("  max %.1f\n", total.latency_max / 1e3);
+
+  //recognition accuracy per performed gesture type
+  int performed[ARM_UNKNOWN + 1], correct[ARM_UNKNOWN + 1], wrong[ARM_UNKNOWN + 1];
+  memset(performed, 0, sizeof(performed));
+  memset(correct, 0, sizeof(correct));
+  memset(wrong, 0, sizeof(wrong));
+  for (int i = 0; i < num_devices; i++) {
+    LoadDevice* device = devices[i];
+    int completed = device->synth->completedGestures(device->last);
+    for (int c = 0; c < completed; c++) performed[device->synth->cycleGesture(c)]++;
+    for (size_t r = 0; r < device->recognitions.size(); r++) {
+      GestureType expected = device->synth->expectedGesture(device->recognitions[r].timestamp);
+      if (device->recognitions[r].gesture == expected) correct[expected]++;
+      else wrong[expected]++;
+    }
+  }
+
+  printf("\n%-12s %9s %9s %9s %9s %9s\n", "gesture", "performed", "correct", "wrong", "missed", "accuracy");
+  int sum_performed = 0, sum_correct = 0, sum_wrong = 0;
+  for (int type = 0; type < ARM_UNKNOWN; type++) {
+    int missed = performed[type] - correct[type] - wrong[type];
+    printf("%-12s %9d %9d %9d %9d %8.1f%%\n", gestureToString((GestureType) type), performed[type], correct[type],
+           wrong[type], missed, performed[type] ? 100. * correct[type] / performed[type] : 0.);
+    sum_performed += performed[type];
+    sum_correct += correct[type];
+    sum_wrong += wrong[type];
+  }
+  //gestures recognized while none was performed
+  printf("%-12s %9s %9s %9d\n", "spurious", "", "", wrong[ARM_UNKNOWN]);
+  printf("%-12s %9d %9d %9d %9d %8.1f%%\n", "total", sum_performed, sum_correct, sum_wrong + wrong[ARM_UNKNOWN],
+         sum_performed - sum_correct - sum_wrong, sum_performed ? 100. * sum_correct / sum_performed : 0.);
+  return 0;
+}
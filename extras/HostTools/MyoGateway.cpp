@@ -0,0 +1,300 @@
+/**
+ * @file   MyoGateway.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Host gateway running the gesture recognition for many armbands.
+ *
+ * Every armband streams HostPacket datagrams to its own socket. The armbands are
+ * distributed over a fixed pool of worker threads (device % workers), every worker owns the
+ * GestureRecognizer instances of its armbands and waits for all of their sockets with epoll.
+ * On every wakeup, up to --batch packets are read from each ready socket at once.
+ * Recognized gestures and lock changes are published as HostPacket datagrams on the output socket.
+ *
+ * Usage:
+ *   MyoGateway --devices N [--workers W] [--input unix:/tmp/myo] [--output udp:127.0.0.1:9100]
+ *              [--batch 32] [--report 1000] [--duration 0]
+ */
+
+#include <signal.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "hostPacket.h"
+#include "hostSocket.h"
+#include "gestureRecognizer.h"
+
+/// maximum number of ready sockets handled per wakeup
+#define GATEWAY_MAX_EVENTS 64
+
+/**
+ * State and statistics of one armband. Statistics are only written by the owning worker.
+ */
+typedef struct GatewayDevice {
+  uint16_t id;
+  int fd;
+  GestureRecognizer recognizer;
+  std::atomic<uint64_t> packets;
+  std::atomic<uint64_t> gestures;
+  std::atomic<uint64_t> latency_sum_ns;
+  std::atomic<uint64_t> latency_max_ns;
+} GatewayDevice;
+
+/**
+ * One worker thread with its share of the armbands.
+ */
+typedef struct GatewayWorker {
+  int epoll_fd;
+  std::vector<GatewayDevice*> devices;
+  std::atomic<uint64_t> wakeups;
+  std::atomic<uint64_t> packets;
+  /// latency since the last report, reset by printReport()
+  std::atomic<uint64_t> interval_packets;
+  std::atomic<uint64_t> interval_latency_sum_ns;
+  std::atomic<uint64_t> interval_latency_max_ns;
+  std::thread thread;
+} GatewayWorker;
+
+static volatile sig_atomic_t running = 1;
+
+static int output_fd = -1;
+static sockaddr_storage output_addr;
+static socklen_t output_len = 0;
+static int batch_size = 32;
+
+static void stopGateway(int) {
+  running = 0;
+}
+
+/**
+ * publish an event of a device on the output socket. Drops the event if nobody listens.
+ */
+static void publish(GatewayDevice* device, uint8_t type, uint8_t value, const HostPacket &cause) {
+  HostPacket packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.type = type;
+  packet.value = value;
+  packet.device = device->id;
+  packet.timestamp = cause.timestamp;
+  packet.sent_ns = hostTimeNs();
+  sendto(output_fd, &packet, sizeof(packet), MSG_DONTWAIT, (sockaddr*) &output_addr, output_len);
+}
+
+/**
+ * run one input packet through the recognizer of its device
+ */
+static void processPacket(GatewayWorker* worker, GatewayDevice* device, HostPacket &packet) {
+  uint8_t events = 0;
+  if (packet.type == HOST_PACKET_IMU) {
+    events = device->recognizer.handleIMUData(packet.imu, packet.timestamp);
+  } else if (packet.type == HOST_PACKET_EMG) {
+    events = device->recognizer.handleEMGData(packet.emg, packet.timestamp);
+  } else {
+    return;
+  }
+
+  if (events & RECOGNIZER_LOCK_CHANGE) {
+    publish(device, HOST_PACKET_LOCK, device->recognizer.isLocked(), packet);
+  }
+  if (events & RECOGNIZER_GESTURE) {
+    publish(device, HOST_PACKET_GESTURE, device->recognizer.getGesture(), packet);
+    device->gestures.store(device->gestures.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  uint64_t latency = hostTimeNs() - packet.sent_ns;
+  device->packets.store(device->packets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  device->latency_sum_ns.store(device->latency_sum_ns.load(std::memory_order_relaxed) + latency, std::memory_order_relaxed);
+  if (latency > device->latency_max_ns.load(std::memory_order_relaxed)) {
+    device->latency_max_ns.store(latency, std::memory_order_relaxed);
+  }
+
+  //the interval values are also written by printReport(), so update them atomically
+  worker->interval_packets.fetch_add(1, std::memory_order_relaxed);
+  worker->interval_latency_sum_ns.fetch_add(latency, std::memory_order_relaxed);
+  uint64_t max = worker->interval_latency_max_ns.load(std::memory_order_relaxed);
+  while ((latency > max) && !worker->interval_latency_max_ns.compare_exchange_weak(max, latency, std::memory_order_relaxed)) {
+  }
+}
+
+static void runWorker(GatewayWorker* worker) {
+  std::vector<HostPacket> packets(batch_size);
+  std::vector<mmsghdr> messages(batch_size);
+  std::vector<iovec> vectors(batch_size);
+
+  for (int i = 0; i < batch_size; i++) {
+    vectors[i].iov_base = &packets[i];
+    vectors[i].iov_len = sizeof(HostPacket);
+    memset(&messages[i], 0, sizeof(mmsghdr));
+    messages[i].msg_hdr.msg_iov = &vectors[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  epoll_event events[GATEWAY_MAX_EVENTS];
+  while (running) {
+    int ready = epoll_wait(worker->epoll_fd, events, GATEWAY_MAX_EVENTS, 100);
+    if (ready <= 0) continue;
+    worker->wakeups.fetch_add(1, std::memory_order_relaxed);
+
+    for (int e = 0; e < ready; e++) {
+      GatewayDevice* device = (GatewayDevice*) events[e].data.ptr;
+
+      //level triggered: packets left over are read on the next wakeup
+      int count = recvmmsg(device->fd, messages.data(), batch_size, MSG_DONTWAIT, NULL);
+      for (int i = 0; i < count; i++) {
+        if (messages[i].msg_len == sizeof(HostPacket)) {
+          processPacket(worker, device, packets[i]);
+        }
+      }
+      if (count > 0) worker->packets.fetch_add(count, std::memory_order_relaxed);
+    }
+  }
+}
+
+static void printReport(std::vector<GatewayWorker*> &workers, std::vector<GatewayDevice*> &devices,
+                        uint64_t &last_packets, uint64_t &last_wakeups, uint64_t &last_time, bool per_device) {
+  uint64_t now = hostTimeNs();
+  uint64_t packets = 0, wakeups = 0, latency_count = 0, latency_sum = 0, latency_max = 0;
+  for (size_t i = 0; i < workers.size(); i++) {
+    packets += workers[i]->packets.load(std::memory_order_relaxed);
+    wakeups += workers[i]->wakeups.load(std::memory_order_relaxed);
+  }
+
+  if (per_device) {
+    //totals over the whole run
+    for (size_t i = 0; i < devices.size(); i++) {
+      latency_count += devices[i]->packets.load(std::memory_order_relaxed);
+      latency_sum += devices[i]->latency_sum_ns.load(std::memory_order_relaxed);
+      latency_max = max(latency_max, (uint64_t) devices[i]->latency_max_ns.load(std::memory_order_relaxed));
+    }
+  } else {
+    //latency of the same interval as the packet rate
+    for (size_t i = 0; i < workers.size(); i++) {
+      latency_count += workers[i]->interval_packets.exchange(0, std::memory_order_relaxed);
+      latency_sum += workers[i]->interval_latency_sum_ns.exchange(0, std::memory_order_relaxed);
+      latency_max = max(latency_max, (uint64_t) workers[i]->interval_latency_max_ns.exchange(0, std::memory_order_relaxed));
+    }
+  }
+
+  double seconds = (now - last_time) / 1e9;
+  printf("%s%.0f packets/s, %.1f packets/wakeup, latency mean %.1f us max %.1f us\n",
+         per_device ? "total: " : "",
+         (packets - last_packets) / seconds,
+         (wakeups > last_wakeups) ? (double) (packets - last_packets) / (wakeups - last_wakeups) : 0.,
+         latency_count ? latency_sum / 1e3 / latency_count : 0.,
+         latency_max / 1e3);
+  last_packets = packets;
+  last_wakeups = wakeups;
+  last_time = now;
+
+  if (per_device) {
+    printf("device,packets,gestures,latency_mean_us,latency_max_us\n");
+    for (size_t i = 0; i < devices.size(); i++) {
+      uint64_t count = devices[i]->packets.load();
+      printf("%u,%llu,%llu,%.1f,%.1f\n", devices[i]->id, (unsigned long long) count,
+             (unsigned long long) devices[i]->gestures.load(),
+             count ? devices[i]->latency_sum_ns.load() / 1e3 / count : 0.,
+             devices[i]->latency_max_ns.load() / 1e3);
+    }
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+  int num_devices = 1;
+  int num_workers = std::thread::hardware_concurrency();
+  const char* input = "unix:/tmp/myo";
+  const char* output = "udp:127.0.0.1:9100";
+  int report_ms = 1000;
+  int duration_s = 0;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--devices")) num_devices = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--workers")) num_workers = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--input")) input = argv[i + 1];
+    else if (!strcmp(argv[i], "--output")) output = argv[i + 1];
+    else if (!strcmp(argv[i], "--batch")) batch_size = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--report")) report_ms = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--duration")) duration_s = atoi(argv[i + 1]);
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (num_workers < 1) num_workers = 1;
+  if (num_workers > num_devices) num_workers = num_devices;
+  if (batch_size < 1) batch_size = 1;
+
+  SocketSpec input_spec, output_spec;
+  if (!parseSocketSpec(input, input_spec) || !parseSocketSpec(output, output_spec)) {
+    fprintf(stderr, "sockets have to be given as unix:<path> or udp:<host>:<port>\n");
+    return 1;
+  }
+
+  output_fd = openSocket(output_spec, -1, false, output_addr, output_len);
+  if (output_fd < 0) return 1;
+
+  std::vector<GatewayWorker*> workers;
+  for (int i = 0; i < num_workers; i++) {
+    GatewayWorker* worker = new GatewayWorker();
+    worker->epoll_fd = epoll_create1(0);
+    workers.push_back(worker);
+  }
+
+  //shard the armbands over the workers
+  std::vector<GatewayDevice*> devices;
+  for (int i = 0; i < num_devices; i++) {
+    sockaddr_storage addr;
+    socklen_t len;
+    GatewayDevice* device = new GatewayDevice();
+    device->id = i;
+    device->fd = openSocket(input_spec, i, true, addr, len);
+    if (device->fd < 0) return 1;
+
+    GatewayWorker* worker = workers[i % num_workers];
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = device;
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, device->fd, &event);
+    worker->devices.push_back(device);
+    devices.push_back(device);
+  }
+
+  signal(SIGINT, stopGateway);
+  signal(SIGTERM, stopGateway);
+
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i]->thread = std::thread(runWorker, workers[i]);
+  }
+  printf("gateway: %d devices on %d workers, batch %d\n", num_devices, num_workers, batch_size);
+
+  uint64_t start = hostTimeNs();
+  uint64_t last_packets = 0, last_wakeups = 0, last_time = start;
+  while (running) {
+    usleep(report_ms * 1000);
+    printReport(workers, devices, last_packets, last_wakeups, last_time, false);
+    if (duration_s && (hostTimeNs() - start) / 1000000000ULL >= (uint64_t) duration_s) running = 0;
+  }
+
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i]->thread.join();
+  }
+
+  //totals over the whole run
+  last_packets = 0;
+  last_wakeups = 0;
+  last_time = start;
+  printReport(workers, devices, last_packets, last_wakeups, last_time, true);
+
+  for (size_t i = 0; i < devices.size(); i++) {
+    close(devices[i]->fd);
+    if (input_spec.is_unix) unlink((input_spec.address + std::to_string(i) + ".sock").c_str());
+    delete devices[i];
+  }
+  for (size_t i = 0; i < workers.size(); i++) {
+    close(workers[i]->epoll_fd);
+    delete workers[i];
+  }
+  close(output_fd);
+  return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file   MyoSimulator.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Stands in for real armbands: streams synthetic sessions to the gateway sockets.
+ *
+ * Every simulated armband sends its IMU and EMG packets in real time (scaled by --speed)
+ * to its own socket, see hostSocket.h. The packets are generated by SessionSynth.
+ *
+ * Usage:
+ *   MyoSimulator --devices N [--input unix:/tmp/myo] [--duration 30] [--speed 1]
+ *                [--noise .01] [--seed 1]
+ */
+
+#include <unistd.h>
+#include <vector>
+#include "hostPacket.h"
+#include "hostSocket.h"
+#include "sessionSynth.h"
+
+int main(int argc, char** argv) {
+  int num_devices = 1;
+  const char* input = "unix:/tmp/myo";
+  double duration_s = 30.;
+  double speed = 1.;
+  uint32_t seed = 1;
+  SynthParams params = defaultSynthParams();
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--devices")) num_devices = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--input")) input = argv[i + 1];
+    else if (!strcmp(argv[i], "--duration")) duration_s = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--speed")) speed = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--noise")) params.noise = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--seed")) seed = atoi(argv[i + 1]);
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  SocketSpec spec;
+  if (!parseSocketSpec(input, spec)) {
+    fprintf(stderr, "sockets have to be given as unix:<path> or udp:<host>:<port>\n");
+    return 1;
+  }
+
+  std::vector<SessionSynth*> synths;
+  std::vector<sockaddr_storage> addrs(num_devices);
+  std::vector<socklen_t> lens(num_devices);
+  std::vector<uint32_t> first(num_devices);
+  int fd = -1;
+  for (int i = 0; i < num_devices; i++) {
+    synths.push_back(new SessionSynth(i, seed * 7919 + i, params));
+    first[i] = synths[i]->peekTime();
+    int device_fd = openSocket(spec, i, false, addrs[i], lens[i]);
+    if (device_fd < 0) return 1;
+    //all armbands send over the same socket
+    if (fd < 0) fd = device_fd;
+    else close(device_fd);
+  }
+
+  uint64_t start = hostTimeNs();
+  uint64_t sent = 0, dropped = 0;
+  HostPacket packet;
+  while (true) {
+    double elapsed_ms = (hostTimeNs() - start) / 1e6 * speed;
+    if (elapsed_ms >= duration_s * 1000.) break;
+
+    for (int i = 0; i < num_devices; i++) {
+      while (synths[i]->peekTime() - first[i] <= elapsed_ms) {
+        synths[i]->next(packet);
+        packet.sent_ns = hostTimeNs();
+        if (sendto(fd, &packet, sizeof(packet), 0, (sockaddr*) &addrs[i], lens[i]) < 0) dropped++;
+        else sent++;
+      }
+    }
+    usleep(1000);
+  }
+
+  printf("sent %llu packets (%.0f/s), %llu failed\n", (unsigned long long) sent,
+         sent / ((hostTimeNs() - start) / 1e9), (unsigned long long) dropped);
+
+  for (int i = 0; i < num_devices; i++) delete synths[i];
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,299 @@
+/**
+ * @file   SessionReplay.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Replays synthetic sessions through GestureRecognizer and compares recognizer settings.
+ *
+ * Every session is generated by SessionSynth and replayed as fast as possible with several recognizer settings:
+ * the IMU stream always enabled, the adaptive IMU stream (see GestureRecognizer::enableAdaptiveIMU()) and
+ * motion trimming with the gyroscope (the default of GestureRecognizer::setMotionSource(), all other settings record all samples).
+ * Switching the IMU stream takes effect --command-delay milliseconds after it was requested, which models
+ * the command round trip over the serial link and Bluetooth. IMU packets sent while the stream is off are dropped.
+ * Packets are processed --latency milliseconds after they were measured. While recording, the orientation the
+ * recognizer uses (as received, or extrapolated by --prediction milliseconds, see GestureRecognizer::setPredictionTime())
+ * is compared to the true orientation at processing time.
+ * Reports the packets per second that reach the recognizer, the packets saved compared to the full stream, the mode
+ * commands per minute and the net saving (saved packets minus commands, as share of all packets), the average number of points per recognized gesture,
+ * the discarded recordings, the mean and 95th percentile orientation error and the recognition accuracy of every setting.
+ * With --telemetry, the first session of the first setting is also written to the given file as telemetry stream
+ * (see telemetry.h), with the frames MyoIMUGestureController sends, for TelemetryDecoder.
+ *
+ * Usage:
+ *   SessionReplay [--sessions 50] [--duration 60] [--command-delay 60] [--idle 300] [--noise .01]
+ *                [--speed-variation .2] [--latency 40] [--prediction 40] [--seed 1] [--telemetry telemetry.bin]
+ */
+
+#include <deque>
+#include "sessionSynth.h"
+#include "gestureRecognizer.h"
+#include "telemetry.h"
+
+/// resolution of the orientation error histogram in degrees
+#define ERROR_RESOLUTION .1
+/// number of bins of the orientation error histogram, the last one collects all larger errors
+#define ERROR_BINS 300
+
+/**
+ * Settings of one replay.
+ */
+typedef struct ReplayOptions {
+  /// name in the report
+  const char* name;
+  /// suspend the IMU stream while locked
+  bool adaptive_imu;
+  /// delay of IMU mode changes in milliseconds
+  uint32_t command_delay;
+  /// MOTION_SOURCE_* for trimming idle samples
+  uint8_t motion_source;
+  /// time in milliseconds the orientation is extrapolated by
+  unsigned int prediction;
+} ReplayOptions;
+
+/**
+ * Results of one or more replays.
+ */
+typedef struct ReplayResult {
+  uint64_t imu_packets;
+  uint64_t emg_packets;
+  uint64_t imu_dropped;
+  uint64_t mode_changes;
+  uint64_t points;
+  int discarded;
+  /// orientation error while recording
+  uint64_t error_histogram[ERROR_BINS];
+  double error_sum;
+  double duration_s;
+  int correct;
+  int wrong;
+  int missed;
+} ReplayResult;
+
+/// a requested IMU mode change, effective at time
+typedef struct ModeChange {
+  uint32_t time;
+  bool imu;
+} ModeChange;
+
+/// angle in degrees between two orientations
+double orientationError(Matrix33 a, Matrix33 b) {
+  //trace of a^T * b
+  double trace = 0.;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) trace += a[i][j] * b[i][j];
+  }
+  double cosine = (trace - 1.) / 2.;
+  cosine = (cosine > 1.) ? 1. : ((cosine < -1.) ? -1. : cosine);
+  return acos(cosine) * 180. / PI;
+}
+
+/// orientation error of an IMU packet processed latency milliseconds after it was measured
+double packetError(SessionSynth &synth, MyoIMUData &imu, uint32_t timestamp, uint32_t latency, unsigned int prediction) {
+  //the orientation the recognizer uses
+  Matrix33 used;
+  if (prediction > 0) {
+    predict_quaternion_to_matrix(used, imu, prediction / 1000.);
+  } else {
+    unit_quaternion_to_matrix(used, (int16_t*) &imu.orientation);
+  }
+
+  SynthMatrix real;
+  synth.trueOrientation(timestamp + latency, real);
+  Matrix33 truth;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) truth[i][j] = real[i][j];
+  }
+
+  return orientationError(used, truth);
+}
+
+void replay(int session, uint32_t seed, const SynthParams &params, uint32_t duration, const ReplayOptions &options,
+            uint32_t latency, bool telemetry, ReplayResult &result) {
+  SessionSynth synth(session, seed, params);
+  GestureRecognizer recognizer;
+  recognizer.enableAdaptiveIMU(options.adaptive_imu);
+  recognizer.setMotionSource(options.motion_source);
+  recognizer.setPredictionTime(options.prediction);
+
+  std::deque<ModeChange> pending;
+  bool imu_on = true;
+  int recognized = 0;
+  uint32_t first = synth.peekTime();
+  HostPacket packet;
+  TelemetryTimer imu_timer, emg_timer;
+  memset(&imu_timer, 0, sizeof(imu_timer));
+  memset(&emg_timer, 0, sizeof(emg_timer));
+  uint32_t counter_time = first;
+  uint8_t emg_packets = 0;
+
+  while (synth.peekTime() < first + duration) {
+    synth.next(packet);
+
+    //the armband applies mode changes in order
+    while (!pending.empty() && (pending.front().time <= packet.timestamp)) {
+      imu_on = pending.front().imu;
+      pending.pop_front();
+    }
+
+    uint8_t events;
+    if (packet.type == HOST_PACKET_IMU) {
+      if (!imu_on) {
+        result.imu_dropped++;
+        continue;
+      }
+      result.imu_packets++;
+
+      if (!recognizer.isLocked()) {
+        double error = packetError(synth, packet.imu, packet.timestamp, latency, options.prediction);
+        int bin = min((int) (error / ERROR_RESOLUTION), ERROR_BINS - 1);
+        result.error_histogram[bin]++;
+        result.error_sum += error;
+      }
+      unsigned long start = micros();
+      events = recognizer.handleIMUData(packet.imu, packet.timestamp);
+      if (telemetry) {
+        addTelemetryTime(imu_timer, micros() - start);
+        sendOrientationTelemetry(packet.timestamp, packet.imu, recognizer.isLocked());
+      }
+    } else {
+      result.emg_packets++;
+      unsigned long start = micros();
+      events = recognizer.handleEMGData(packet.emg, packet.timestamp);
+      if (telemetry) {
+        addTelemetryTime(emg_timer, micros() - start);
+        if (++emg_packets >= TELEMETRY_EMG_DIVIDER) {
+          emg_packets = 0;
+          sendEMGTelemetry(packet.timestamp, recognizer.getEMGSum(), recognizer.getSyncValue());
+        }
+      }
+    }
+
+    //the frames of MyoIMUGestureController::handleEvents()
+    if (telemetry) {
+      if (events & RECOGNIZER_SYNC_START) sendSyncTelemetry(packet.timestamp, TELEMETRY_SYNC_START, recognizer.getSyncValue());
+      if (events & RECOGNIZER_SYNC_DONE) sendSyncTelemetry(packet.timestamp, TELEMETRY_SYNC_DONE, recognizer.getSyncValue());
+      if (events & RECOGNIZER_LOCK_CHANGE) sendLockTelemetry(packet.timestamp, recognizer.isLocked());
+      if (events & RECOGNIZER_GESTURE) {
+        sendGestureTelemetry(packet.timestamp, recognizer.getGesture(), recognizer.getGestureFeatures());
+      }
+      if (packet.timestamp - counter_time >= TELEMETRY_COUNTER_INTERVAL) {
+        counter_time = packet.timestamp;
+        sendCounterTelemetry(packet.timestamp, imu_timer, emg_timer);
+      }
+    }
+
+    if (events & RECOGNIZER_IMU_CHANGE) {
+      ModeChange change;
+      change.time = packet.timestamp + options.command_delay;
+      change.imu = recognizer.wantsIMU();
+      pending.push_back(change);
+      result.mode_changes++;
+    }
+
+    //the automatic re-lock after sync is not a discarded gesture
+    if ((events & RECOGNIZER_GESTURE_DISCARDED) && (synth.completedGestures(packet.timestamp) > 0)) {
+      result.discarded++;
+    }
+
+    if (events & RECOGNIZER_GESTURE) {
+      result.points += recognizer.getGesturePoints();
+      if (recognizer.getGesture() == synth.expectedGesture(packet.timestamp)) result.correct++;
+      else result.wrong++;
+      recognized++;
+    }
+  }
+
+  result.missed += synth.completedGestures(first + duration) - recognized;
+  result.duration_s += duration / 1000.;
+}
+
+void printResult(const ReplayOptions &options, const ReplayResult &result, const ReplayResult &reference) {
+  uint64_t samples = 0;
+  for (int i = 0; i < ERROR_BINS; i++) samples += result.error_histogram[i];
+  int p95 = 0;
+  for (uint64_t count = 0; (p95 < ERROR_BINS - 1) && (count + result.error_histogram[p95] < .95 * samples); p95++) {
+    count += result.error_histogram[p95];
+  }
+
+  double imu_rate = result.imu_packets / result.duration_s;
+  double total_rate = (result.imu_packets + result.emg_packets) / result.duration_s;
+  double reference_rate = (reference.imu_packets + reference.emg_packets) / reference.duration_s;
+  //every mode change is a command on the same link
+  double command_rate = result.mode_changes / result.duration_s;
+  double net_rate = reference_rate - total_rate - command_rate;
+  int recognized = result.correct + result.wrong;
+  printf("%-12s %7.1f %7.1f %7.1f %6.1f%% %9.2f %7.1f %6.1f%% %6.1f %9d %6.2f %6.1f %7d %7d %7d\n", options.name, imu_rate,
+         total_rate, reference_rate - total_rate, 100. * (reference_rate - total_rate) / reference_rate,
+         command_rate * 60., net_rate, 100. * net_rate / reference_rate, recognized ? (double) result.points / recognized : 0.,
+         result.discarded, samples ? result.error_sum / samples : 0., (p95 + 1) * ERROR_RESOLUTION,
+         result.correct, result.wrong, result.missed);
+}
+
+int main(int argc, char** argv) {
+  int sessions = 50;
+  double duration_s = 60.;
+  uint32_t command_delay = 60;
+  uint32_t latency = 40;
+  unsigned int prediction = 40;
+  uint32_t seed = 1;
+  const char* telemetry_name = NULL;
+  SynthParams params = defaultSynthParams();
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--sessions")) sessions = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--duration")) duration_s = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--command-delay")) command_delay = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--idle")) params.idle_time = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--noise")) params.noise = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--speed-variation")) params.speed_variation = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--latency")) latency = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--prediction")) prediction = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--seed")) seed = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--telemetry")) telemetry_name = argv[i + 1];
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  ReplayOptions options[] = {
+    {"full", false, command_delay, MOTION_SOURCE_NONE, 0},
+    {"adaptive", true, command_delay, MOTION_SOURCE_NONE, 0},
+    {"trim", false, command_delay, MOTION_SOURCE_GYRO, 0},
+    {"predict", false, command_delay, MOTION_SOURCE_NONE, prediction},
+  };
+  const int num_options = sizeof(options) / sizeof(options[0]);
+
+  HostSerial telemetry_serial(NULL);
+  if (telemetry_name != NULL) {
+    telemetry_serial.file = fopen(telemetry_name, "wb");
+    if (telemetry_serial.file == NULL) {
+      perror(telemetry_name);
+      return 1;
+    }
+    beginTelemetry(telemetry_serial);
+  }
+
+  ReplayResult results[num_options];
+  memset(results, 0, sizeof(results));
+  for (int o = 0; o < num_options; o++) {
+    for (int s = 0; s < sessions; s++) {
+      bool telemetry = (telemetry_name != NULL) && (o == 0) && (s == 0);
+      replay(s, seed * 7919 + s, params, duration_s * 1000., options[o], latency, telemetry, results[o]);
+    }
+  }
+
+  if (telemetry_name != NULL) {
+    //the file takes everything, only the transmit buffer of HostSerial is limited
+    while (telemetryBufferedBytes() > 0) flushTelemetry();
+    endTelemetry();
+    fclose(telemetry_serial.file);
+  }
+
+  //rates per armband
+  printf("%-12s %7s %7s %7s %7s %9s %7s %7s %6s %9s %6s %6s %7s %7s %7s\n", "setting", "imu/s", "total/s", "saved/s", "saved",
+         "modes/min", "net/s", "net", "points", "discarded", "err", "p95", "correct", "wrong", "missed");
+  for (int o = 0; o < num_options; o++) {
+    printResult(options[o], results[o], results[0]);
+  }
+  return 0;
+}
@@ -0,0 +1,295 @@
+/**
+ * @file   TelemetryDecoder.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Decodes the binary telemetry stream of MyoIMUGestureController into CSV and trace files.
+ *
+ * Reads the stream (see telemetry.h) from a file, a serial device configured with stty or stdin.
+ * Frames are split at the zero bytes, COBS decoded and checked with their CRC; damaged frames are counted and skipped,
+ * the decoder resynchronizes at the next zero byte. Every frame type is written to its own CSV file <prefix>_<type>.csv.
+ * With --trace, a trace in the Chrome trace event format is written as well (open with chrome://tracing or Perfetto):
+ * unlocked periods, recognized gestures, sync events, the EMG envelope and the handler timing.
+ * The stream may start or end in an unlocked period, e.g. when the decoder is started after the armband was connected:
+ * such a period begins with the first or ends with the last frame of the stream.
+ *
+ * Usage:
+ *   TelemetryDecoder [--input telemetry.bin] [--csv telemetry] [--trace telemetry.json]
+ */
+
+#include "telemetry.h"
+
+/// maximum length of an encoded frame without the delimiter
+#define DECODER_MAX_ENCODED (TELEMETRY_MAX_FRAME + 4)
+/// number of frame types, including the unused 0
+#define DECODER_TYPES 7
+
+/// file name suffixes and CSV headers of the frame types
+const char* frame_names[DECODER_TYPES] = {NULL, "orientation", "emg", "lock", "gesture", "counters", "sync"};
+const char* frame_headers[DECODER_TYPES] = {
+  NULL,
+  "time_ms,qw,qx,qy,qz,gyro_x_dps,gyro_y_dps,gyro_z_dps,locked",
+  "time_ms,emg_sum,emg_sync,level",
+  "time_ms,locked",
+  "time_ms,gesture,num_points,x_mean,y_mean,x_deviation,y_deviation,ends_distance,box_diagonal,"
+  "circle_radius,circle_deviation,distance,roll_angle",
+  "time_ms,imu_packets,imu_avg_us,imu_max_us,emg_packets,emg_avg_us,emg_max_us,dropped_frames",
+  "time_ms,event,emg_sync",
+};
+/// length of type and payload of the frame types
+const int frame_lengths[DECODER_TYPES] = {0, 20, 9, 6, 48, 19, 10};
+const char* sync_events[] = {"start", "done", "update", "loaded", "rejected"};
+
+/// little endian readers, independent of the host byte order
+uint16_t readU16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+uint32_t readU32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+float readFloat(const uint8_t* p) {
+  uint32_t bits = readU32(p);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * Output files and statistics.
+ */
+typedef struct Decoder {
+  FILE* csv[DECODER_TYPES];
+  FILE* trace;
+  bool first_event;
+  /// an unlocked period was begun in the trace and not ended yet
+  bool unlocked;
+  /// a frame was written, first_time is valid
+  bool started;
+  /// time of the first and the last frame
+  uint32_t first_time, last_time;
+  uint64_t frames[DECODER_TYPES];
+  uint64_t crc_errors;
+  uint64_t invalid;
+  uint64_t unknown;
+  uint16_t dropped;
+} Decoder;
+
+/// start a trace event, the caller writes the rest of the object
+void traceEvent(Decoder &decoder, const char* phase, const char* name, uint32_t time) {
+  fprintf(decoder.trace, "%s\n{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":1,\"ts\":%llu", decoder.first_event ? "" : ",",
+          phase, name, (unsigned long long) time * 1000ULL);
+  decoder.first_event = false;
+}
+
+/// write a decoded and checked frame, returns false if a value is out of range
+bool writeFrame(Decoder &decoder, const uint8_t* frame) {
+  uint8_t type = frame[0];
+  uint32_t time = readU32(frame + 1);
+  const uint8_t* p = frame + 5;
+  FILE* csv = decoder.csv[type];
+  FILE* trace = decoder.trace;
+
+  if (!decoder.started) {
+    decoder.first_time = time;
+    decoder.started = true;
+  }
+  decoder.last_time = time;
+
+  switch (type) {
+    case TELEMETRY_ORIENTATION:
+      fprintf(csv, "%u,%.5f,%.5f,%.5f,%.5f,%.2f,%.2f,%.2f,%u\n", time,
+              (int16_t) readU16(p) / MYOHW_ORIENTATION_SCALE, (int16_t) readU16(p + 2) / MYOHW_ORIENTATION_SCALE,
+              (int16_t) readU16(p + 4) / MYOHW_ORIENTATION_SCALE, (int16_t) readU16(p + 6) / MYOHW_ORIENTATION_SCALE,
+              (int16_t) readU16(p + 8) / MYOHW_GYROSCOPE_SCALE, (int16_t) readU16(p + 10) / MYOHW_GYROSCOPE_SCALE,
+              (int16_t) readU16(p + 12) / MYOHW_GYROSCOPE_SCALE, p[14]);
+      break;
+
+    case TELEMETRY_EMG: {
+      uint16_t sum = readU16(p);
+      uint16_t sync = readU16(p + 2);
+      double level = sync ? (double) sum / sync : 0.;
+      fprintf(csv, "%u,%u,%u,%.3f\n", time, sum, sync, level);
+      if (trace) {
+        traceEvent(decoder, "C", "emg", time);
+        fprintf(trace, ",\"args\":{\"level\":%.3f}}", level);
+      }
+      break;
+    }
+
+    case TELEMETRY_LOCK:
+      fprintf(csv, "%u,%u\n", time, p[0]);
+      if (trace && !p[0] && !decoder.unlocked) {
+        traceEvent(decoder, "B", "unlocked", time);
+        fprintf(trace, "}");
+        decoder.unlocked = true;
+      } else if (trace && p[0]) {
+        //the stream started while unlocked
+        if (!decoder.unlocked) {
+          traceEvent(decoder, "B", "unlocked", decoder.first_time);
+          fprintf(trace, "}");
+        }
+        traceEvent(decoder, "E", "unlocked", time);
+        fprintf(trace, "}");
+        decoder.unlocked = false;
+      }
+      break;
+
+    case TELEMETRY_GESTURE: {
+      //gestureToString() does not check the range
+      if (p[0] > ARM_UNKNOWN) {
+        return false;
+      }
+      float values[10];
+      for (int i = 0; i < 10; i++) values[i] = readFloat(p + 3 + 4 * i);
+      const char* name = gestureToString((GestureType) p[0]);
+      fprintf(csv, "%u,%s,%u", time, name, readU16(p + 1));
+      for (int i = 0; i < 10; i++) fprintf(csv, ",%.4f", values[i]);
+      fprintf(csv, "\n");
+      if (trace) {
+        traceEvent(decoder, "i", name, time);
+        fprintf(trace, ",\"s\":\"g\",\"args\":{\"points\":%u,\"circle_radius\":%.4f,\"circle_deviation\":%.4f,"
+                "\"ends_distance\":%.4f,\"roll_angle\":%.4f}}", readU16(p + 1), values[6], values[7], values[4], values[9]);
+      }
+      break;
+    }
+
+    case TELEMETRY_COUNTERS:
+      decoder.dropped = readU16(p + 12);
+      fprintf(csv, "%u,%u,%u,%u,%u,%u,%u,%u\n", time, readU16(p), readU16(p + 2), readU16(p + 4),
+              readU16(p + 6), readU16(p + 8), readU16(p + 10), decoder.dropped);
+      if (trace) {
+        traceEvent(decoder, "C", "handler_us", time);
+        fprintf(trace, ",\"args\":{\"imu_avg\":%u,\"imu_max\":%u,\"emg_avg\":%u,\"emg_max\":%u}}", readU16(p + 2),
+                readU16(p + 4), readU16(p + 8), readU16(p + 10));
+      }
+      break;
+
+    case TELEMETRY_SYNC: {
+      const char* event = (p[0] <= TELEMETRY_SYNC_REJECTED) ? sync_events[p[0]] : "unknown";
+      fprintf(csv, "%u,%s,%d\n", time, event, (int32_t) readU32(p + 1));
+      if (trace) {
+        traceEvent(decoder, "i", "sync", time);
+        fprintf(trace, ",\"s\":\"g\",\"args\":{\"event\":\"%s\",\"emg_sync\":%d}}", event, (int32_t) readU32(p + 1));
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+/// decode, check and write one encoded frame
+void handleFrame(Decoder &decoder, const uint8_t* encoded, int length) {
+  uint8_t frame[DECODER_MAX_ENCODED];
+  int decoded = cobsDecode(encoded, length, frame);
+  if (decoded < 3) {
+    decoder.invalid++;
+    return;
+  }
+
+  uint16_t crc = frame[decoded - 2] | (frame[decoded - 1] << 8);
+  if (telemetryCRC(frame, decoded - 2) != crc) {
+    decoder.crc_errors++;
+    return;
+  }
+
+  uint8_t type = frame[0];
+  if ((type == 0) || (type >= DECODER_TYPES)) {
+    decoder.unknown++;
+    return;
+  }
+  if (decoded - 2 != frame_lengths[type]) {
+    decoder.invalid++;
+    return;
+  }
+
+  if (!writeFrame(decoder, frame)) {
+    decoder.invalid++;
+    return;
+  }
+  decoder.frames[type]++;
+}
+
+int main(int argc, char** argv) {
+  const char* input_name = NULL;
+  const char* prefix = "telemetry";
+  const char* trace_name = NULL;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--input")) input_name = argv[i + 1];
+    else if (!strcmp(argv[i], "--csv")) prefix = argv[i + 1];
+    else if (!strcmp(argv[i], "--trace")) trace_name = argv[i + 1];
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  FILE* input = input_name ? fopen(input_name, "rb") : stdin;
+  if (input == NULL) {
+    perror(input_name);
+    return 1;
+  }
+
+  Decoder decoder;
+  memset(&decoder, 0, sizeof(decoder));
+  for (int type = 1; type < DECODER_TYPES; type++) {
+    char name[256];
+    snprintf(name, sizeof(name), "%s_%s.csv", prefix, frame_names[type]);
+    decoder.csv[type] = fopen(name, "w");
+    if (decoder.csv[type] == NULL) {
+      perror(name);
+      return 1;
+    }
+    fprintf(decoder.csv[type], "%s\n", frame_headers[type]);
+  }
+  if (trace_name != NULL) {
+    decoder.trace = fopen(trace_name, "w");
+    if (decoder.trace == NULL) {
+      perror(trace_name);
+      return 1;
+    }
+    fprintf(decoder.trace, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    decoder.first_event = true;
+  }
+
+  //split the stream at the delimiters
+  uint8_t encoded[DECODER_MAX_ENCODED];
+  int length = 0;
+  bool overflow = false;
+  uint8_t chunk[4096];
+  size_t count;
+  while ((count = fread(chunk, 1, sizeof(chunk), input)) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      if (chunk[i] == 0) {
+        if (overflow) decoder.invalid++;
+        else if (length > 0) handleFrame(decoder, encoded, length);
+        length = 0;
+        overflow = false;
+      } else if (length < DECODER_MAX_ENCODED) {
+        encoded[length++] = chunk[i];
+      } else {
+        overflow = true;
+      }
+    }
+  }
+  //an incomplete frame at the end is not an error, the stream was just cut
+
+  if (decoder.trace) {
+    //the stream ended while unlocked
+    if (decoder.unlocked) {
+      traceEvent(decoder, "E", "unlocked", decoder.last_time);
+      fprintf(decoder.trace, "}");
+    }
+    fprintf(decoder.trace, "\n]}\n");
+    fclose(decoder.trace);
+  }
+  for (int type = 1; type < DECODER_TYPES; type++) {
+    fclose(decoder.csv[type]);
+    fprintf(stderr, "%-12s %10llu\n", frame_names[type], (unsigned long long) decoder.frames[type]);
+  }
+  fprintf(stderr, "%-12s %10llu\n%-12s %10llu\n%-12s %10llu\n%-12s %10u\n", "crc errors",
+          (unsigned long long) decoder.crc_errors, "invalid", (unsigned long long) decoder.invalid, "unknown",
+          (unsigned long long) decoder.unknown, "dropped", decoder.dropped);
+  return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file   Arduino.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Minimal Arduino core replacement to build the library analysis code on a host.
+ *
+ * Only provides what the files in src/include use. Not part of the Arduino library itself.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+
+#define PI 3.1415926535897932384626433832795
+
+#define F(string_literal) (string_literal)
+
+typedef uint8_t byte;
+
+template<typename T> inline T max(T a, T b) {
+  return (a > b) ? a : b;
+}
+
+template<typename T> inline T min(T a, T b) {
+  return (a < b) ? a : b;
+}
+
+/// milliseconds since an arbitrary point (monotonic clock)
+inline unsigned long millis() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long) ts.tv_sec * 1000UL + ts.tv_nsec / 1000000UL;
+}
+
+/// microseconds since an arbitrary point (monotonic clock)
+inline unsigned long micros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long) ts.tv_sec * 1000000UL + ts.tv_nsec / 1000UL;
+}
+
+/**
+ * Stand-in for the hardware serial connection, prints to stdout.
+ * Binary data (write()) goes to the given file, which never blocks.
+ */
+class HostSerial {
+  public:
+    HostSerial(FILE* output = stdout) : file(output) {}
+    int availableForWrite() { return 64; }
+    size_t write(uint8_t value) { return fputc(value, file) == EOF ? 0 : 1; }
+    void print(const char* text) { fputs(text, stdout); }
+    void print(double value) { printf("%.2f", value); }
+    void print(long value) { printf("%ld", value); }
+    void println(const char* text) { puts(text); }
+    void println(double value) { printf("%.2f\n", value); }
+    void println(long value) { printf("%ld\n", value); }
+
+    /// destination of write()
+    FILE* file;
+};
+
+typedef HostSerial HardwareSerial;
+typedef HostSerial Print;
+
+static HostSerial Serial __attribute__((unused));
+
+#endif //HOST_ARDUINO_H
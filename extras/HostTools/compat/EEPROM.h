@@ -0,0 +1,66 @@
+/**
+ * @file   EEPROM.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  EEPROM replacement in RAM to check the calibration profiles on a host.
+ *
+ * Provides the interface of the AVR EEPROM library used by calibration.cpp, plus begin()/commit()
+ * of the ESP8266/ESP32 flash emulation. Counts writes and commits. Not part of the Arduino library itself.
+ */
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <Arduino.h>
+
+/// size of the simulated EEPROM in bytes, as on an ATmega328P
+#define HOST_EEPROM_SIZE 1024
+
+class EEPROMClass {
+  public:
+    /// erased EEPROM reads 0xFF
+    EEPROMClass() : writes(0), commits(0) { memset(data, 0xFF, sizeof(data)); }
+
+    uint16_t length() { return HOST_EEPROM_SIZE; }
+    void begin(size_t) {}
+    bool commit() { commits++; return true; }
+
+    uint8_t read(int address) { return data[address]; }
+
+    /// only changed bytes are written and counted, like EEPROM.update()
+    void update(int address, uint8_t value) {
+      if (data[address] != value) {
+        data[address] = value;
+        writes++;
+      }
+    }
+    void write(int address, uint8_t value) { update(address, value); }
+
+    template<typename T> T &get(int address, T &value) {
+      memcpy(&value, data + address, sizeof(T));
+      return value;
+    }
+
+    template<typename T> const T &put(int address, const T &value) {
+      const uint8_t* bytes = (const uint8_t*) &value;
+      for (size_t i = 0; i < sizeof(T); i++) update(address + i, bytes[i]);
+      return value;
+    }
+
+    /// contents, may be changed directly to simulate damage
+    uint8_t data[HOST_EEPROM_SIZE];
+    /// number of bytes written
+    unsigned long writes;
+    /// number of commit() calls
+    unsigned long commits;
+};
+
+/// one instance shared by all translation units
+inline EEPROMClass &hostEEPROM() {
+  static EEPROMClass eeprom;
+  return eeprom;
+}
+
+static EEPROMClass &EEPROM __attribute__((unused)) = hostEEPROM();
+
+#endif //HOST_EEPROM_H
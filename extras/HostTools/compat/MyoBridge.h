@@ -0,0 +1,32 @@
+/**
+ * @file   MyoBridge.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Data types of the MyoBridge library needed to build the library analysis code on a host.
+ *
+ * The layout of MyoIMUData follows myohw_imu_data_t of the Myo bluetooth protocol,
+ * as used by the MyoBridge Arduino Library (https://github.com/vroland/MyoBridge).
+ */
+
+#ifndef HOST_MYOBRIDGE_H
+#define HOST_MYOBRIDGE_H
+
+#include <Arduino.h>
+
+/// See myohw_imu_data_t::orientation
+#define MYOHW_ORIENTATION_SCALE 16384.0f
+/// See myohw_imu_data_t::accelerometer
+#define MYOHW_ACCELEROMETER_SCALE 2048.0f
+/// See myohw_imu_data_t::gyroscope
+#define MYOHW_GYROSCOPE_SCALE 16.0f
+
+/// IMU packet of the Myo armband
+typedef struct MyoIMUData {
+  struct {
+    int16_t w, x, y, z;
+  } orientation;
+  int16_t accelerometer[3];
+  int16_t gyroscope[3];
+} MyoIMUData;
+
+#endif //HOST_MYOBRIDGE_H
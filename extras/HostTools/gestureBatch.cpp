@@ -0,0 +1,375 @@
+/**
+ * @file   gestureBatch.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Implementation file for the classification of many gestures at once.
+ *
+ * Host only: a GestureBatch does not fit into the RAM of an Arduino, and the code relies on
+ * a host compiler with SIMD support. Not part of the Arduino library itself.
+ *
+ * Every step of processCacheData() is done for all gestures of the batch in an inner loop over
+ * the lanes, which the compiler turns into SIMD instructions. Gestures with fewer points are
+ * padded with copies of their first point, which changes no maximum or minimum, and are
+ * masked out of the sums instead of leaving the loop early. The float operations of every lane are the same,
+ * in the same order, as in processCacheData(), so the results are identical.
+ * The lane loops are kept from being unrolled (#pragma GCC unroll 1), otherwise GCC unrolls them
+ * before the loop vectorizer sees them.
+ * The math functions are only vectorized without errno handling (-fno-math-errno), and
+ * contraction to fused multiply-add has to be disabled (-ffp-contract=off) for identical results.
+ */
+
+#include "gestureBatch.h"
+
+#define LANES GESTURE_BATCH_LANES
+
+inline float sqr(float a) {
+  return a*a;
+}
+
+inline float getSqrPointDist(float x1, float y1, float x2, float y2) {
+  return sqr(x1-x2)+sqr(y1-y2);
+}
+
+/**
+ * Empties a batch.
+ */
+void resetGestureBatch(GestureBatch &batch) {
+  batch.count = 0;
+  for (int l=0;l<LANES;l++) {
+    batch.num_points[l] = 0;
+    batch.roll_angle[l] = 0;
+  }
+}
+
+/**
+ * Moves the data of a gesture cache to the batch.
+ */
+bool addToGestureBatch(GestureBatch &batch, GestureCache &cache) {
+  if (batch.count >= LANES) {
+    return false;
+  }
+
+  int lane = batch.count++;
+  int num_points = cache.offset / 2;
+  for (int i=0;i<num_points;i++) {
+    batch.x[i][lane] = cache.data[2 * i];
+    batch.y[i][lane] = cache.data[2 * i + 1];
+  }
+  //padding: a copy of a point that is already part of the gesture
+  for (int i=num_points;i<GESTURE_CACHE_SIZE / 2;i++) {
+    batch.x[i][lane] = (num_points > 0) ? cache.data[0] : 0;
+    batch.y[i][lane] = (num_points > 0) ? cache.data[1] : 0;
+  }
+  batch.num_points[lane] = num_points;
+  batch.roll_angle[lane] = cache.roll_angle;
+
+  cache.offset = 0;
+  cache.active_end = 0;
+  cache.idle_samples = 0;
+  return true;
+}
+
+/**
+ * Recognizes all gestures of a batch.
+ */
+void processGestureBatch(GestureBatch &batch, GestureType* results) {
+
+  int max_points = 0;
+  for (int l=0;l<LANES;l++) {
+    if (batch.num_points[l] > max_points) max_points = batch.num_points[l];
+  }
+
+  //unused lanes are evaluated like empty gestures
+  for (int l=batch.count;l<LANES;l++) {
+    batch.num_points[l] = 0;
+    for (int i=0;i<max_points;i++) {
+      batch.x[i][l] = 0;
+      batch.y[i][l] = 0;
+    }
+  }
+
+  //local copies, so the compiler does not have to assume aliasing with the point data
+  int num_points[LANES];
+  int last[LANES];
+  //number of points as float, for masking without mixing integer and float vectors
+  float limit[LANES];
+  for (int l=0;l<LANES;l++) {
+    num_points[l] = batch.num_points[l];
+    last[l] = (num_points[l] > 0) ? num_points[l] - 1 : 0;
+    limit[l] = num_points[l];
+  }
+
+  /***************************************************
+   * Test for circular movement
+   **************************************************/
+
+  short index_offset[LANES];
+  bool circle[LANES];
+  bool clockwise[LANES];
+
+  //squared diameters: the maximum of the squared distances gives the same result as the maximum of the distances
+  float sample_point_diameters[GESTURE_CIRCLE_SAMPLES][LANES];
+  float center_x[LANES];
+  float center_y[LANES];
+
+  bool any_circle = false;
+  for (int l=0;l<LANES;l++) {
+    index_offset[l] = (int)(num_points[l])/ GESTURE_CIRCLE_SAMPLES;
+    center_x[l] = 0;
+    center_y[l] = 0;
+    circle[l] = false;
+    clockwise[l] = false;
+    any_circle |= (index_offset[l] >= 1);
+  }
+
+  if (any_circle) {
+
+    // find the greatest distance to another point (diameter) for all sample points
+    for (int j=0;j<GESTURE_CIRCLE_SAMPLES;j++) {
+
+      float point_x[LANES];
+      float point_y[LANES];
+      for (int l=0;l<LANES;l++) {
+        point_x[l] = batch.x[j * index_offset[l]][l];
+        point_y[l] = batch.y[j * index_offset[l]][l];
+        center_x[l] += point_x[l];
+        center_y[l] += point_y[l];
+      }
+
+      float diameters[LANES] = {0};
+      for (int i=0;i<max_points;i++) {
+        const float* x = batch.x[i];
+        const float* y = batch.y[i];
+        #pragma GCC unroll 1
+        for (int l=0;l<LANES;l++) {
+          float dist = getSqrPointDist(point_x[l], point_y[l], x[l], y[l]);
+          diameters[l] = (dist > diameters[l]) ? dist : diameters[l];
+        }
+      }
+
+      for (int l=0;l<LANES;l++) {
+        sample_point_diameters[j][l] = diameters[l];
+      }
+    }
+
+    float average_radius[LANES];
+    float circular_deviation[LANES];
+    //indices are stored as float to keep the loop in float vectors
+    float y_max[LANES];
+    float y_max_index[LANES];
+    float x_max[LANES];
+    float x_max_index[LANES];
+    float x_min[LANES];
+    float x_min_index[LANES];
+
+    for (int l=0;l<LANES;l++) {
+      // calculate circle center
+      center_x[l] /= (float) GESTURE_CIRCLE_SAMPLES;
+      center_y[l] /= (float) GESTURE_CIRCLE_SAMPLES;
+
+      //get average circle radius
+      average_radius[l] = 0;
+      for (int j=0;j<GESTURE_CIRCLE_SAMPLES;j++) {
+        average_radius[l] += sqrt(sample_point_diameters[j][l]);
+      }
+      average_radius[l] /= (float) GESTURE_CIRCLE_SAMPLES * 2.;
+
+      circular_deviation[l] = 0;
+      y_max[l] = 0.;
+      y_max_index[l] = 0;
+      x_max[l] = 0.;
+      x_max_index[l] = 0;
+      x_min[l] = 1000.;
+      x_min_index[l] = 0;
+    }
+
+    //get standard deviation of the radius
+    for (int i=0;i<max_points;i++) {
+      const float* x = batch.x[i];
+      const float* y = batch.y[i];
+      float index = i;
+      #pragma GCC unroll 1
+      for (int l=0;l<LANES;l++) {
+        float dist = sqrt(getSqrPointDist(center_x[l], center_y[l], x[l], y[l]));
+        circular_deviation[l] += (index < limit[l]) ? sqr(dist - average_radius[l]) : 0.f;
+
+        // track minima/maxima
+        bool new_x_max = (x[l] > x_max[l]);
+        x_max[l] = new_x_max ? x[l] : x_max[l];
+        x_max_index[l] = new_x_max ? index : x_max_index[l];
+
+        bool new_x_min = (x[l] < x_min[l]);
+        x_min[l] = new_x_min ? x[l] : x_min[l];
+        x_min_index[l] = new_x_min ? index : x_min_index[l];
+
+        bool new_y_max = (y[l] > y_max[l]);
+        y_max[l] = new_y_max ? y[l] : y_max[l];
+        y_max_index[l] = new_y_max ? index : y_max_index[l];
+      }
+    }
+
+    for (int l=0;l<LANES;l++) {
+      if (index_offset[l] < 1) continue;
+
+      //calculate deviation
+      circular_deviation[l] = sqrt(circular_deviation[l] / (float) num_points[l]);
+
+      //determine if the circle is nearly closed
+      float ends_distance = sqrt(getSqrPointDist(batch.x[0][l], batch.y[0][l],
+                                 batch.x[last[l]][l], batch.y[last[l]][l]));
+
+      //determine clockwise/counterclockwise
+      if ((x_min_index[l] < y_max_index[l]) && (y_max_index[l] < x_max_index[l])) {
+        clockwise[l] = true;
+      }
+      if ((y_max_index[l] < x_max_index[l]) && (x_max_index[l] < x_min_index[l])) {
+        clockwise[l] = true;
+      }
+      if ((x_max_index[l] < x_min_index[l]) && (x_min_index[l] < y_max_index[l])) {
+        clockwise[l] = true;
+      }
+
+      //are all conditions met?
+      circle[l] = (average_radius[l] * 2. >= CIRCLE_MIN_DIAMETER) && (circular_deviation[l] <= CIRCLE_MAX_DEVIATION) && (ends_distance <= MAX_ENDS_DISCANCE);
+    }
+  }
+
+  /***************************************************
+   * Gather some statistical data
+   **************************************************/
+
+  float x_total[LANES];
+  float y_total[LANES];
+  float x_deviation[LANES];
+  float y_deviation[LANES];
+
+  for (int l=0;l<LANES;l++) {
+    x_total[l] = 0.;
+    y_total[l] = 0.;
+    x_deviation[l] = 0;
+    y_deviation[l] = 0;
+  }
+
+  //get sum of all points and X/Y deviation
+  for (int i=0;i<max_points;i++) {
+    const float* x = batch.x[i];
+    const float* y = batch.y[i];
+    float index = i;
+    #pragma GCC unroll 1
+    for (int l=0;l<LANES;l++) {
+      bool valid = (index < limit[l]);
+      x_total[l] += valid ? x[l] : 0.f;
+      y_total[l] += valid ? y[l] : 0.f;
+      x_deviation[l] += valid ? sqr(x[l]) : 0.f;
+      y_deviation[l] += valid ? sqr(y[l]) : 0.f;
+    }
+  }
+
+  for (int l=0;l<batch.count;l++) {
+
+    if (circle[l]) {
+      results[l] = clockwise[l] ? ARM_CIRCLE_CW : ARM_CIRCLE_CCW;
+      continue;
+    }
+
+    //calculate deviations
+    x_deviation[l] /= (float) num_points[l];
+    y_deviation[l] /= (float) num_points[l];
+
+    //correct y deviation because of more limited movement
+    y_deviation[l] *= Y_DEVIATION_CORRECTION;
+
+    //deviation relation
+    float relation = x_deviation[l]/y_deviation[l];
+    float roll_angle = batch.roll_angle[l];
+
+    //arm rotation?
+    if ((x_deviation[l] <= ROTATION_MAX_VARIANCE) && (y_deviation[l] <= ROTATION_MAX_VARIANCE) && (sqr(roll_angle) > sqr(ROTATION_MIN_ANGLE))) {
+      results[l] = (roll_angle<0) ? ARM_ROTATE_CW : ARM_ROTATE_CCW;
+      continue;
+    }
+
+    //determine the distance from (0,0)
+    float distance = sqrt(getSqrPointDist(0, 0, batch.x[last[l]][l], batch.y[last[l]][l]));
+
+    //horizontal movement?
+    if ((x_deviation[l] > y_deviation[l]) && (relation > 1./STRAIGHT_MAX_RELATION) && (distance >= STRAIGHT_MIN_DISTANCE)) {
+      results[l] = (x_total[l] > 0) ? ARM_RIGHT : ARM_LEFT;
+      continue;
+    }
+
+    //vertical movement?
+    if ((y_deviation[l] > x_deviation[l]) && (relation < STRAIGHT_MAX_RELATION) && (distance >= STRAIGHT_MIN_DISTANCE)) {
+      results[l] = (y_total[l] > 0) ? ARM_UP : ARM_DOWN;
+      continue;
+    }
+
+    //no gesture detected
+    results[l] = ARM_UNKNOWN;
+  }
+}
+
+//ends distance and bounding box of the cached data, the thresholds are in isCircleCandidate()
+static bool cacheIsCircleCandidate(GestureCache &cache) {
+  float* gesture_cache = cache.data;
+  int num_points = cache.offset / 2;
+  if (num_points == 0) {
+    return false;
+  }
+
+  float ends_distance = sqrt(getSqrPointDist(gesture_cache[0], gesture_cache[1],
+                             gesture_cache[2 * num_points - 2], gesture_cache[2 * num_points - 1]));
+
+  float box_x_min = gesture_cache[0];
+  float box_x_max = gesture_cache[0];
+  float box_y_min = gesture_cache[1];
+  float box_y_max = gesture_cache[1];
+  for (int i=0;i<num_points;i++) {
+    box_x_min = min(box_x_min, gesture_cache[2 * i]);
+    box_x_max = max(box_x_max, gesture_cache[2 * i]);
+    box_y_min = min(box_y_min, gesture_cache[2 * i + 1]);
+    box_y_max = max(box_y_max, gesture_cache[2 * i + 1]);
+  }
+
+  return isCircleCandidate(num_points, ends_distance, getSqrPointDist(box_x_min, box_y_min, box_x_max, box_y_max));
+}
+
+/**
+ * Recognizes the gestures of count caches.
+ */
+void processCacheDataBatch(GestureCache* caches, int count, GestureType* results) {
+  GestureBatch batch;
+  //result index of every lane
+  int indices[LANES];
+
+  resetGestureBatch(batch);
+  for (int i=0;i<count;i++) {
+
+    //only the circle test profits from the batch
+    if (!cacheIsCircleCandidate(caches[i])) {
+      results[i] = processCacheData(caches[i]);
+      continue;
+    }
+
+    indices[batch.count] = i;
+    addToGestureBatch(batch, caches[i]);
+
+    if (batch.count == LANES) {
+      GestureType batch_results[LANES];
+      processGestureBatch(batch, batch_results);
+      for (int l=0;l<batch.count;l++) {
+        results[indices[l]] = batch_results[l];
+      }
+      resetGestureBatch(batch);
+    }
+  }
+
+  //remaining gestures
+  if (batch.count > 0) {
+    GestureType batch_results[LANES];
+    processGestureBatch(batch, batch_results);
+    for (int l=0;l<batch.count;l++) {
+      results[indices[l]] = batch_results[l];
+    }
+  }
+}
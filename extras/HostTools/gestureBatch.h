@@ -0,0 +1,62 @@
+/**
+ * @file   gestureBatch.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Header file describing the classification of many gestures at once.
+ *
+ * Host only: a GestureBatch does not fit into the RAM of an Arduino, and the code relies on
+ * a host compiler with SIMD support. Not part of the Arduino library itself.
+ */
+
+#ifndef GESTUREBATCH_H
+#define GESTUREBATCH_H
+
+#include "gestureAnalysis.h"
+
+/// Number of gestures evaluated side by side, one per SIMD lane (8 for AVX, 16 for AVX-512)
+#ifndef GESTURE_BATCH_LANES
+#define GESTURE_BATCH_LANES 8
+#endif
+
+/**
+ * Gesture data of up to GESTURE_BATCH_LANES gestures in structure-of-arrays layout:
+ * the coordinates of point i of all gestures are stored next to each other.
+ */
+typedef struct GestureBatch {
+  /// x coordinates, [point][gesture]
+  float x[GESTURE_CACHE_SIZE / 2][GESTURE_BATCH_LANES];
+  /// y coordinates, [point][gesture]
+  float y[GESTURE_CACHE_SIZE / 2][GESTURE_BATCH_LANES];
+  /// number of points of every gesture
+  int num_points[GESTURE_BATCH_LANES];
+  /// last roll angle of every gesture
+  float roll_angle[GESTURE_BATCH_LANES];
+  /// number of gestures in the batch
+  int count;
+} GestureBatch;
+
+/**
+ * Empties a batch.
+ */
+void resetGestureBatch(GestureBatch &batch);
+
+/**
+ * Moves the data of a gesture cache to the batch. Like processCacheData(), this resets the cache.
+ * Returns false if the batch is already full.
+ */
+bool addToGestureBatch(GestureBatch &batch, GestureCache &cache);
+
+/**
+ * Recognizes all gestures of a batch. The results are identical to processCacheData()
+ * for every single gesture. results needs space for batch.count entries.
+ */
+void processGestureBatch(GestureBatch &batch, GestureType* results);
+
+/**
+ * Recognizes the gestures of count caches. Gestures that can not be circles (see isCircleCandidate())
+ * are evaluated one by one, the others GESTURE_BATCH_LANES at a time.
+ * Equivalent to calling processCacheData() for every cache.
+ */
+void processCacheDataBatch(GestureCache* caches, int count, GestureType* results);
+
+#endif
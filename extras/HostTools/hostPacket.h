@@ -0,0 +1,54 @@
+/**
+ * @file   hostPacket.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Datagram format used between the host tools (simulator, gateway and its clients).
+ *
+ * Every datagram carries exactly one HostPacket. Input packets contain IMU or EMG data of one armband,
+ * output packets contain a recognized gesture or a lock status change.
+ */
+
+#ifndef HOSTPACKET_H
+#define HOSTPACKET_H
+
+#include <MyoBridge.h>
+
+/// IMU data (input)
+#define HOST_PACKET_IMU 1
+/// EMG data (input)
+#define HOST_PACKET_EMG 2
+/// recognized gesture, value is the GestureType (output)
+#define HOST_PACKET_GESTURE 3
+/// lock status change, value is 1 if locked (output)
+#define HOST_PACKET_LOCK 4
+
+/**
+ * One packet of an armband stream.
+ */
+typedef struct HostPacket {
+  /// one of the HOST_PACKET_* constants
+  uint8_t type;
+  /// gesture or lock status for output packets
+  uint8_t value;
+  /// index of the armband
+  uint16_t device;
+  /// armband time of the packet in milliseconds
+  uint32_t timestamp;
+  /// host monotonic time when the packet was sent, used for latency measurement
+  uint64_t sent_ns;
+  union {
+    MyoIMUData imu;
+    int8_t emg[8];
+  };
+} HostPacket;
+
+/**
+ * Host monotonic time in nanoseconds. Comparable between processes on the same machine.
+ */
+inline uint64_t hostTimeNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif //HOSTPACKET_H
@@ -0,0 +1,115 @@
+/**
+ * @file   hostSocket.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Datagram socket helpers shared by the host tools.
+ *
+ * Sockets are given as "unix:<path>" or "udp:<host>:<port>". Armband streams use one socket
+ * per device: "unix:/tmp/myo" becomes /tmp/myo0.sock, /tmp/myo1.sock, ..., and
+ * "udp:127.0.0.1:9000" becomes the ports 9000, 9001, ...
+ */
+
+#ifndef HOSTSOCKET_H
+#define HOSTSOCKET_H
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <string>
+
+/**
+ * Parsed socket specification.
+ */
+typedef struct SocketSpec {
+  /// UNIX datagram socket (otherwise UDP)
+  bool is_unix;
+  /// socket path or path prefix for UNIX sockets, host name for UDP
+  std::string address;
+  /// (base) port for UDP
+  int port;
+} SocketSpec;
+
+/**
+ * Parse "unix:<path>" or "udp:<host>:<port>". Returns false on malformed input.
+ */
+inline bool parseSocketSpec(const char* text, SocketSpec &spec) {
+  if (strncmp(text, "unix:", 5) == 0) {
+    spec.is_unix = true;
+    spec.address = text + 5;
+    spec.port = 0;
+    return !spec.address.empty();
+  }
+  if (strncmp(text, "udp:", 4) == 0) {
+    const char* colon = strrchr(text + 4, ':');
+    if (colon == NULL) return false;
+    spec.is_unix = false;
+    spec.address = std::string(text + 4, colon - text - 4);
+    spec.port = atoi(colon + 1);
+    return !spec.address.empty() && (spec.port > 0);
+  }
+  return false;
+}
+
+/**
+ * Fill the socket address of a spec. device >= 0 selects the socket of that armband,
+ * -1 uses the address unchanged.
+ */
+inline bool resolveSocketSpec(const SocketSpec &spec, int device, sockaddr_storage &addr, socklen_t &len) {
+  memset(&addr, 0, sizeof(addr));
+  if (spec.is_unix) {
+    sockaddr_un* un = (sockaddr_un*) &addr;
+    un->sun_family = AF_UNIX;
+    std::string path = spec.address;
+    if (device >= 0) path += std::to_string(device) + ".sock";
+    if (path.size() >= sizeof(un->sun_path)) return false;
+    strcpy(un->sun_path, path.c_str());
+    len = sizeof(sockaddr_un);
+    return true;
+  }
+
+  addrinfo hints;
+  addrinfo* result = NULL;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  std::string port = std::to_string(spec.port + (device >= 0 ? device : 0));
+  if (getaddrinfo(spec.address.c_str(), port.c_str(), &hints, &result) != 0) return false;
+  memcpy(&addr, result->ai_addr, result->ai_addrlen);
+  len = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+/**
+ * Open a datagram socket for a spec. If bind_address is set, the socket is bound to the
+ * address (receiving side), otherwise the address is only stored in addr (sending side).
+ * Returns the file descriptor or -1.
+ */
+inline int openSocket(const SocketSpec &spec, int device, bool bind_address, sockaddr_storage &addr, socklen_t &len) {
+  if (!resolveSocketSpec(spec, device, addr, len)) {
+    fprintf(stderr, "cannot resolve socket address for device %d\n", device);
+    return -1;
+  }
+
+  int fd = socket(addr.ss_family, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  if (bind_address) {
+    if (spec.is_unix) unlink(((sockaddr_un*) &addr)->sun_path);
+    if (bind(fd, (sockaddr*) &addr, len) != 0) {
+      perror("bind");
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+#endif //HOSTSOCKET_H
@@ -0,0 +1,457 @@
+/**
+ * @file   sessionSynth.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Synthetic IMU/EMG packet streams of one armband for the host tools.
+ *
+ * A session starts with a strong EMG burst during the sync time, followed by an idle phase
+ * until the recognizer has re-locked. After that, gesture cycles follow each other:
+ * unlock pose, rest, movement, hold, lock pose, return to the rest orientation, idle.
+ * The gesture of every cycle is picked at random from all recognizable gesture types.
+ */
+
+#ifndef SESSIONSYNTH_H
+#define SESSIONSYNTH_H
+
+#include <math.h>
+#include <random>
+#include <vector>
+#include "hostPacket.h"
+#include "gestureAnalysis.h"
+
+/// Myo IMU packet period in milliseconds (50 Hz)
+#define SYNTH_IMU_PERIOD 20
+/// Myo EMG sample period in milliseconds (200 Hz)
+#define SYNTH_EMG_PERIOD 5
+
+/// start of the sync burst, relative to the first packet
+#define SYNTH_SYNC_START 800
+/// duration of the sync burst
+#define SYNTH_SYNC_TIME 1000
+/// start of the first gesture cycle, after sync and the automatic re-lock
+#define SYNTH_FIRST_CYCLE 6000
+
+/// Phase lengths of one gesture cycle in milliseconds
+
+/// duration of the lock/unlock pose
+#define SYNTH_POSE_TIME 300
+/// rest between unlock pose and movement
+#define SYNTH_REST_TIME 100
+/// nominal duration of the movement
+#define SYNTH_MOTION_TIME 650
+/// holding the end position before the lock pose
+#define SYNTH_HOLD_TIME 100
+/// returning to the rest orientation
+#define SYNTH_RETURN_TIME 400
+/// default idle time at the end of a cycle
+#define SYNTH_IDLE_TIME 300
+
+/// nominal distance of straight movements in rad
+#define SYNTH_STRAIGHT_DISTANCE .55
+/// nominal circle radius in rad
+#define SYNTH_CIRCLE_RADIUS .4
+/// nominal arm rotation in rad
+#define SYNTH_ROTATION_ANGLE .9
+
+/// EMG amplitude at rest
+#define SYNTH_EMG_REST 4
+/// additional EMG amplitude of the sync gesture
+#define SYNTH_EMG_STRONG 60
+/// strength of the lock/unlock pose relative to the sync gesture
+#define SYNTH_POSE_LEVEL .9
+
+/**
+ * Variation parameters of the synthesized streams.
+ */
+typedef struct SynthParams {
+  /// standard deviation of the orientation noise in rad
+  float noise;
+  /// maximum relative variation of the movement duration
+  float speed_variation;
+  /// maximum relative variation of the movement size
+  float size_variation;
+  /// IMU packet period in milliseconds
+  int imu_period;
+  /// EMG sample period in milliseconds
+  int emg_period;
+  /// idle time at the end of every gesture cycle in milliseconds
+  int idle_time;
+} SynthParams;
+
+inline SynthParams defaultSynthParams() {
+  SynthParams params;
+  params.noise = .01;
+  params.speed_variation = .2;
+  params.size_variation = .15;
+  params.imu_period = SYNTH_IMU_PERIOD;
+  params.emg_period = SYNTH_EMG_PERIOD;
+  params.idle_time = SYNTH_IDLE_TIME;
+  return params;
+}
+
+/// 3x3 matrix in double precision, only used for synthesis
+typedef double SynthMatrix[3][3];
+
+/**
+ * Generates the packet stream of one armband in time order.
+ */
+class SessionSynth {
+  public:
+
+    /**
+     * @param device index of the armband, stored in the packets
+     * @param seed random seed, equal seeds produce equal streams
+     * @param params variation parameters
+     */
+    SessionSynth(uint16_t device, uint32_t seed, const SynthParams &params)
+        : device(device), params(params), rng(seed), noise_rng(seed ^ 0x5EED), uniform(0., 1.), gaussian(0., 1.) {
+      //start at an arbitrary time, 0 means "not connected" for the recognizer
+      start = 1000 + (seed % 1000);
+      next_imu = start;
+      next_emg = start;
+      base_yaw = uniform(rng) * 2. * PI;
+      base_pitch = (uniform(rng) - .5) * .6;
+      cycle_start = start + SYNTH_FIRST_CYCLE;
+      newCycle();
+    }
+
+    /// timestamp of the packet next() will return
+    uint32_t peekTime() {
+      return (next_imu <= next_emg) ? next_imu : next_emg;
+    }
+
+    /**
+     * Produce the next packet. sent_ns is left at 0.
+     */
+    void next(HostPacket &packet) {
+      memset(&packet, 0, sizeof(packet));
+      packet.device = device;
+
+      if (next_imu <= next_emg) {
+        packet.type = HOST_PACKET_IMU;
+        packet.timestamp = next_imu;
+        fillIMU(packet.imu, next_imu);
+        next_imu += params.imu_period;
+      } else {
+        packet.type = HOST_PACKET_EMG;
+        packet.timestamp = next_emg;
+        fillEMG(packet.emg, next_emg);
+        next_emg += params.emg_period;
+      }
+    }
+
+    /**
+     * The gesture the user performed when a gesture was recognized at the given time.
+     * ARM_UNKNOWN if no gesture was performed at that time.
+     */
+    GestureType expectedGesture(uint32_t timestamp) {
+      for (int i = cycles.size() - 1; i >= 0; i--) {
+        if (timestamp >= cycles[i].lock_start) {
+          //a gesture is evaluated at the start of the lock pose
+          if (timestamp < cycles[i].lock_start + SYNTH_POSE_TIME) return cycles[i].gesture;
+          return ARM_UNKNOWN;
+        }
+      }
+      return ARM_UNKNOWN;
+    }
+
+    /// number of gesture cycles whose lock pose has started before timestamp
+    int completedGestures(uint32_t timestamp) {
+      int count = 0;
+      for (size_t i = 0; i < cycles.size(); i++) {
+        if (cycles[i].lock_start <= timestamp) count++;
+      }
+      return count;
+    }
+
+    /// the gesture of a cycle, cycles are numbered in time order as counted by completedGestures()
+    GestureType cycleGesture(int index) {
+      return cycles[index].gesture;
+    }
+
+    /**
+     * The orientation the arm really has at a given time, without noise, as the matrix
+     * unit_quaternion_to_matrix() builds from the packets.
+     */
+    void trueOrientation(uint32_t time, SynthMatrix out) {
+      orientation(time, out);
+    }
+
+    /**
+     * Record a new random gesture directly into a gesture cache, as the recognizer would
+     * between the unlock and the lock pose. Starts a new cycle, so do not mix with next().
+     * Returns the performed gesture.
+     */
+    GestureType recordGesture(GestureCache &cache) {
+      newCycle();
+      resetGestureCache(cache);
+
+      uint32_t duration = SYNTH_REST_TIME + motion_time + SYNTH_HOLD_TIME;
+      for (uint32_t t = 0; t < duration; t += params.imu_period) {
+        double alpha, beta, roll;
+        path(smoothstep(((double) t - SYNTH_REST_TIME) / motion_time), alpha, beta, roll);
+        alpha += params.noise * gaussian(noise_rng);
+        beta += params.noise * gaussian(noise_rng);
+        roll += params.noise * gaussian(noise_rng);
+
+        SynthMatrix rz, rx, ry, tmp, local;
+        rotation(2, roll, rz);
+        rotation(0, alpha, rx);
+        rotation(1, beta, ry);
+        multiply(rz, rx, tmp);
+        multiply(tmp, ry, local);
+        updateGestureCache(cache, local[2][1], local[2][0], asin(local[1][0]));
+      }
+      return gesture;
+    }
+
+  private:
+
+    /// timing and gesture of one cycle
+    typedef struct Cycle {
+      uint32_t start;
+      uint32_t lock_start;
+      GestureType gesture;
+    } Cycle;
+
+    uint16_t device;
+    SynthParams params;
+    /// random numbers of the gesture cycles
+    std::mt19937 rng;
+    /// random numbers of the sensor noise, separate so that queries like trueOrientation() do not change the session
+    std::mt19937 noise_rng;
+    std::uniform_real_distribution<double> uniform;
+    std::normal_distribution<double> gaussian;
+
+    uint32_t start;
+    uint32_t next_imu;
+    uint32_t next_emg;
+
+    /// rest orientation of the arm
+    double base_yaw;
+    double base_pitch;
+
+    /// current cycle
+    uint32_t cycle_start;
+    uint32_t motion_time;
+    double size;
+    GestureType gesture;
+    std::vector<Cycle> cycles;
+
+    void newCycle() {
+      gesture = (GestureType) (rng() % ARM_UNKNOWN);
+      motion_time = SYNTH_MOTION_TIME * (1. + params.speed_variation * (2. * uniform(rng) - 1.));
+      size = 1. + params.size_variation * (2. * uniform(rng) - 1.);
+
+      Cycle cycle;
+      cycle.start = cycle_start;
+      cycle.lock_start = cycle_start + SYNTH_POSE_TIME + SYNTH_REST_TIME + motion_time + SYNTH_HOLD_TIME;
+      cycle.gesture = gesture;
+      cycles.push_back(cycle);
+    }
+
+    uint32_t cycleLength() {
+      return 2 * SYNTH_POSE_TIME + SYNTH_REST_TIME + motion_time + SYNTH_HOLD_TIME
+             + SYNTH_RETURN_TIME + params.idle_time;
+    }
+
+    /// advance the current cycle until it contains time
+    void selectCycle(uint32_t time) {
+      while (time >= cycle_start + cycleLength()) {
+        cycle_start += cycleLength();
+        newCycle();
+      }
+    }
+
+    static double smoothstep(double s) {
+      s = (s < 0.) ? 0. : ((s > 1.) ? 1. : s);
+      return s * s * (3. - 2. * s);
+    }
+
+    /// pointing angles and roll of the current gesture at progress s
+    void path(double s, double &alpha, double &beta, double &roll) {
+      double angle = 2. * PI * s;
+      double straight = SYNTH_STRAIGHT_DISTANCE * size * s;
+      double radius = SYNTH_CIRCLE_RADIUS * size;
+      double x = 0., y = 0.;
+      roll = 0.;
+
+      switch (gesture) {
+        case ARM_UP:         y = straight; break;
+        case ARM_DOWN:       y = -straight; break;
+        case ARM_RIGHT:      x = straight; break;
+        case ARM_LEFT:       x = -straight; break;
+        case ARM_CIRCLE_CW:  x = radius * sin(angle);  y = radius * cos(angle) - radius; break;
+        case ARM_CIRCLE_CCW: x = -radius * sin(angle); y = radius * cos(angle) - radius; break;
+        case ARM_ROTATE_CW:  roll = -SYNTH_ROTATION_ANGLE * size * s; break;
+        case ARM_ROTATE_CCW: roll = SYNTH_ROTATION_ANGLE * size * s; break;
+        default: break;
+      }
+
+      //the library records asin(local[2][1]) as x and asin(local[2][0]) as y
+      alpha = x;
+      beta = -y;
+    }
+
+    /// arm angles relative to the rest orientation, without noise
+    void pose(uint32_t time, double &alpha, double &beta, double &roll) {
+      alpha = beta = roll = 0.;
+      if (time < cycle_start) return;
+
+      selectCycle(time);
+      double t = time - cycle_start;
+      double motion_start = SYNTH_POSE_TIME + SYNTH_REST_TIME;
+      double motion_end = motion_start + motion_time;
+      double return_start = motion_end + SYNTH_HOLD_TIME + SYNTH_POSE_TIME;
+
+      if (t < motion_start) return;
+      if (t < return_start) {
+        path(smoothstep((t - motion_start) / motion_time), alpha, beta, roll);
+        return;
+      }
+      path(1., alpha, beta, roll);
+      double back = 1. - smoothstep((t - return_start) / SYNTH_RETURN_TIME);
+      alpha *= back;
+      beta *= back;
+      roll *= back;
+    }
+
+    /// EMG strength: 0 at rest, 1 for the sync gesture
+    double emgLevel(uint32_t time) {
+      if ((time >= start + SYNTH_SYNC_START) && (time < start + SYNTH_SYNC_START + SYNTH_SYNC_TIME)) return 1.;
+      if (time < cycle_start) return 0.;
+
+      selectCycle(time);
+      uint32_t t = time - cycle_start;
+      uint32_t lock_start = SYNTH_POSE_TIME + SYNTH_REST_TIME + motion_time + SYNTH_HOLD_TIME;
+      if (t < SYNTH_POSE_TIME) return SYNTH_POSE_LEVEL;
+      if ((t >= lock_start) && (t < lock_start + SYNTH_POSE_TIME)) return SYNTH_POSE_LEVEL;
+      return 0.;
+    }
+
+    static void multiply(SynthMatrix a, SynthMatrix b, SynthMatrix out) {
+      for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+          out[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+        }
+      }
+    }
+
+    static void rotation(int axis, double angle, SynthMatrix out) {
+      double c = cos(angle), s = sin(angle);
+      int a = (axis + 1) % 3, b = (axis + 2) % 3;
+      memset(out, 0, sizeof(SynthMatrix));
+      out[axis][axis] = 1.;
+      out[a][a] = c;
+      out[a][b] = -s;
+      out[b][a] = s;
+      out[b][b] = c;
+    }
+
+    /// absolute orientation: Rz(roll) * Rx(alpha) * Ry(beta) * base
+    void orientation(uint32_t time, SynthMatrix out, double noise = 0.) {
+      double alpha, beta, roll;
+      pose(time, alpha, beta, roll);
+      if (noise > 0.) {
+        alpha += noise * gaussian(noise_rng);
+        beta += noise * gaussian(noise_rng);
+        roll += noise * gaussian(noise_rng);
+      }
+
+      SynthMatrix rz, rx, ry, base_z, base_x, base, tmp, tmp2;
+      rotation(2, roll, rz);
+      rotation(0, alpha, rx);
+      rotation(1, beta, ry);
+      rotation(2, base_yaw, base_z);
+      rotation(0, base_pitch, base_x);
+      multiply(base_z, base_x, base);
+      multiply(rz, rx, tmp);
+      multiply(tmp, ry, tmp2);
+      multiply(tmp2, base, out);
+    }
+
+    /// inverse of unit_quaternion_to_matrix(), quat is x, y, z, w
+    static void matrixToQuaternion(SynthMatrix m, double* quat) {
+      double trace = m[0][0] + m[1][1] + m[2][2];
+      double x, y, z, w;
+      if (trace > 0.) {
+        double s = .5 / sqrt(trace + 1.);
+        w = .25 / s;
+        x = (m[2][1] - m[1][2]) * s;
+        y = (m[0][2] - m[2][0]) * s;
+        z = (m[1][0] - m[0][1]) * s;
+      } else if ((m[0][0] > m[1][1]) && (m[0][0] > m[2][2])) {
+        double s = 2. * sqrt(1. + m[0][0] - m[1][1] - m[2][2]);
+        w = (m[2][1] - m[1][2]) / s;
+        x = .25 * s;
+        y = (m[0][1] + m[1][0]) / s;
+        z = (m[0][2] + m[2][0]) / s;
+      } else if (m[1][1] > m[2][2]) {
+        double s = 2. * sqrt(1. + m[1][1] - m[0][0] - m[2][2]);
+        w = (m[0][2] - m[2][0]) / s;
+        x = (m[0][1] + m[1][0]) / s;
+        y = .25 * s;
+        z = (m[1][2] + m[2][1]) / s;
+      } else {
+        double s = 2. * sqrt(1. + m[2][2] - m[0][0] - m[1][1]);
+        w = (m[1][0] - m[0][1]) / s;
+        x = (m[0][2] + m[2][0]) / s;
+        y = (m[1][2] + m[2][1]) / s;
+        z = .25 * s;
+      }
+      quat[0] = x;
+      quat[1] = y;
+      quat[2] = z;
+      quat[3] = w;
+    }
+
+    static int16_t toRaw(double value, double scale) {
+      double raw = value * scale;
+      if (raw > 32767.) raw = 32767.;
+      if (raw < -32768.) raw = -32768.;
+      return (int16_t) lround(raw);
+    }
+
+    void fillIMU(MyoIMUData &imu, uint32_t time) {
+      SynthMatrix m;
+      orientation(time, m, params.noise);
+
+      //unit_quaternion_to_matrix() reads MyoIMUData::orientation (w, x, y, z) in memory order as x, y, z, w
+      double quat[4];
+      matrixToQuaternion(m, quat);
+      imu.orientation.w = toRaw(quat[0], MYOHW_ORIENTATION_SCALE);
+      imu.orientation.x = toRaw(quat[1], MYOHW_ORIENTATION_SCALE);
+      imu.orientation.y = toRaw(quat[2], MYOHW_ORIENTATION_SCALE);
+      imu.orientation.z = toRaw(quat[3], MYOHW_ORIENTATION_SCALE);
+
+      //gravity in sensor coordinates
+      for (int i = 0; i < 3; i++) imu.accelerometer[i] = toRaw(m[2][i], MYOHW_ACCELEROMETER_SCALE);
+
+      //angular velocity in sensor coordinates: q_next = q * delta
+      SynthMatrix m_next;
+      double q[4], n[4];
+      orientation(time, m);
+      orientation(time + 1, m_next);
+      matrixToQuaternion(m, q);
+      matrixToQuaternion(m_next, n);
+      double delta[4] = {
+        q[0]*n[0] + q[1]*n[1] + q[2]*n[2] + q[3]*n[3],
+        q[0]*n[1] - q[1]*n[0] - q[2]*n[3] + q[3]*n[2],
+        q[0]*n[2] + q[1]*n[3] - q[2]*n[0] - q[3]*n[1],
+        q[0]*n[3] - q[1]*n[2] + q[2]*n[1] - q[3]*n[0],
+      };
+      //q and -q are the same orientation, take the short way
+      double sign = (delta[0] < 0.) ? -1. : 1.;
+      double per_second = 2. * 1000. * 180. / PI;
+      for (int i = 0; i < 3; i++) imu.gyroscope[i] = toRaw(sign * delta[i + 1] * per_second, MYOHW_GYROSCOPE_SCALE);
+    }
+
+    void fillEMG(int8_t* emg, uint32_t time) {
+      double amplitude = SYNTH_EMG_REST + emgLevel(time) * SYNTH_EMG_STRONG;
+      for (int i = 0; i < 8; i++) {
+        emg[i] = (int8_t) lround((2. * uniform(noise_rng) - 1.) * amplitude);
+      }
+    }
+};
+
+#endif //SESSIONSYNTH_H
@@ -20,28 +20,27 @@ void (*MyoIMUGestureController::on_gesture)(GestureType);
 void (*MyoIMUGestureController::on_lock_change)(bool);
 
 ///The MyoBridge object used
-MyoBridge* MyoIMUGestureController::bridge;
+MyoBridge* MyoIMUGestureController::bridge = NULL;
 
-///reference orientation. Set on unlock.
-Matrix33 MyoIMUGestureController::inverseInitMatrix = ZERO_MATRIX;
-///tell the IMU handle to save a new inverse init matrix
-bool MyoIMUGestureController::refresh_init = true;
+///recognition state of the connected armband
+GestureRecognizer MyoIMUGestureController::recognizer;
 
-///the EMG data cache. used to smooth out EMG data
-int8_t MyoIMUGestureController::emgCache[EMG_CACHE_SIZE][8] = {0};
-///sum of the absolute value of all EMG data stored in the cache.
-long MyoIMUGestureController::emgSum = 0;
-///maximum emgSum during sync time, used as reference.
-long MyoIMUGestureController::emgSync = 0;
-///Is EMG synced? (reference value stored)
-bool MyoIMUGestureController::isEMGSynced = false;
-///Does the user currently do the lock/unlock pose? Used to toggle the lock state.
-bool MyoIMUGestureController::lock_toggle = true; 
-///Is the device unlocked to store data?
-bool MyoIMUGestureController::locked;
+///EEPROM address of the calibration profiles, -1 if disabled
+int MyoIMUGestureController::calibration_address = -1;
+///key of the calibration profile
+uint8_t MyoIMUGestureController::armband_key[CALIBRATION_KEY_SIZE];
+///is the current sync value stored in the calibration profile?
+bool MyoIMUGestureController::calibration_stored = false;
 
-/// the time in milliseconds passed since connection
-unsigned long MyoIMUGestureController::timeConnected = 0;
+///processing time of the data handlers for telemetry
+TelemetryTimer MyoIMUGestureController::imu_timer;
+TelemetryTimer MyoIMUGestureController::emg_timer;
+///time of the last TELEMETRY_COUNTERS frame
+unsigned long MyoIMUGestureController::counter_time;
+///EMG packets since the last TELEMETRY_EMG frame
+uint8_t MyoIMUGestureController::emg_packets;
+///the IMU mode has to be sent to the armband by update()
+bool MyoIMUGestureController::imu_mode_pending = false;
 
 
 /**
@@ -49,6 +48,7 @@ unsigned long MyoIMUGestureController::timeConnected = 0;
  * MyoBridge object: It will disable sleep, enable IMU and EMG data and set its own functions
  * as callbacks. The MyoBridge object is also used to send commands like vibrations.
  * Call after MyoBridge.connect()!
+ * If calibration profiles are enabled and one is stored for the armband, syncing is skipped.
  * 
  * @param myoBridge The MyoBridge object to use.
  * @param onGesture Callback for gesture recognition
@@ -71,128 +71,242 @@ void MyoIMUGestureController::begin(MyoBridge &myoBridge, void (*onGesture)(Gest
   //disable Myo sleep mode
   bridge->disableSleep(); 
   
-  //vibrate long to signalize start of syncing process
-  bridge->vibrate(3);
+  //use the stored calibration profile if there is one
+  long emgSync;
+  calibration_stored = (calibration_address >= 0) && loadCalibration(calibration_address, armband_key, emgSync);
+  if (calibration_stored) {
+    recognizer.loadSyncValue(emgSync);
+
+    if (telemetryEnabled()) {
+      sendSyncTelemetry(millis(), TELEMETRY_SYNC_LOADED, emgSync);
+    } else {
+      #ifdef DEBUG_SERIAL
+      Serial.print(F("Using stored calibration: "));
+      Serial.println(emgSync);
+      #endif
+    }
+
+    //vibrate short to signalize the controller is ready
+    bridge->vibrate(1);
+    on_lock_change(recognizer.isLocked());
+  } else {
+    //vibrate long to signalize start of syncing process
+    bridge->vibrate(3);
+  }
+}
+
+/**
+ * Store the sync value in EEPROM as calibration profile.
+ */
+void MyoIMUGestureController::enableCalibration(int eepromAddress, const uint8_t* armbandKey) {
+  calibration_address = eepromAddress;
+  memset(armband_key, 0, CALIBRATION_KEY_SIZE);
+  if (armbandKey != NULL) {
+    memcpy(armband_key, armbandKey, CALIBRATION_KEY_SIZE);
+  }
+}
+
+/**
+ * Refine the stored sync value with every lock/unlock gesture.
+ */
+void MyoIMUGestureController::setResync(bool enable) {
+  recognizer.enableResync(enable);
+}
+
+/**
+ * Delete the calibration profile of the armband.
+ */
+void MyoIMUGestureController::forgetCalibration() {
+  if (calibration_address >= 0) {
+    clearCalibration(calibration_address, armband_key);
+  }
+  calibration_stored = false;
+}
+
+/**
+ * Is the current sync value stored as calibration profile?
+ */
+bool MyoIMUGestureController::isCalibrationStored() {
+  return calibration_stored;
+}
+
+/**
+ * Suspend the IMU data stream while locked and idle.
+ */
+void MyoIMUGestureController::setAdaptiveIMU(bool enable) {
+  recognizer.enableAdaptiveIMU(enable);
+  //before begin() there is no bridge yet, begin() enables the stream anyway
+  if (!enable && (bridge != NULL)) {
+    bridge->setIMUMode(IMU_MODE_SEND_DATA);
+  }
+}
+
+/**
+ * Send pending commands to the armband.
+ */
+void MyoIMUGestureController::update() {
+  if (imu_mode_pending && (bridge != NULL)) {
+    imu_mode_pending = false;
+    bridge->setIMUMode(recognizer.wantsIMU() ? IMU_MODE_SEND_DATA : IMU_MODE_NONE);
+  }
+}
+
+/**
+ * Send binary telemetry frames over the given serial port.
+ */
+void MyoIMUGestureController::enableTelemetry(Print &serial) {
+  beginTelemetry(serial);
+  memset(&imu_timer, 0, sizeof(imu_timer));
+  memset(&emg_timer, 0, sizeof(emg_timer));
+  counter_time = millis();
+  emg_packets = 0;
 }
 
 /**
  * handle the IMU data
  */
 void MyoIMUGestureController::handleIMUData(MyoIMUData& data) {
-  
-  //build matrix of the current absolute orientation
-  Matrix33 matrix = ZERO_MATRIX; 
-  Matrix33 local = ZERO_MATRIX; 
-  
-  unit_quaternion_to_matrix(matrix, (int16_t*)&data.orientation);
-  
-  //save initial orientation matrix, is reset on unlock. Used for reference
-  if (refresh_init) {
-    inverse_matrix(matrix, inverseInitMatrix);
-    refresh_init = false;
+  unsigned long now = millis();
+  unsigned long start = micros();
+  uint8_t events = recognizer.handleIMUData(data, now);
+
+  if (telemetryEnabled()) {
+    addTelemetryTime(imu_timer, micros() - start);
+    sendOrientationTelemetry(now, data, recognizer.isLocked());
   }
-  
-  multiply_matrix(matrix, inverseInitMatrix, local);
-  
-  float roll_angle = asin(local[1][0]);
-  
-  //enable locking/unlocking feature after a certain delay after sync
-  if (isEMGSynced && (timeConnected + EMG_SYNC_TIME + AFTER_SYNC_WAIT < millis())) {
-	
-    if ((float) emgSum/ (float) emgSync < LOCK_TOGGLE_THRESHOLD) {
-	  
-		//discard gesture if the buffer is full -> user is probably inactive or gesture incomplete
-		if ((!locked) && gestureBufferFull()) {
-			
-			resetGestureCache();
-			// initiate re-locking
-			lock_toggle = false;
-		}
-	
-		//toggle lock
-		if (!lock_toggle) {
-			
-			lock_toggle = true;
-			locked = !locked;
-
-			//end of unlocking gesture
-			if (!locked) {
-				resetGestureCache();
-			}
-
-			on_lock_change(locked);
-		}
-      
-    } else {
-      if (lock_toggle) {
-         refresh_init = true;
-         lock_toggle = false; 
-
-         //begin of locking gesture
-         if (!locked) {
-          
-          //get the recognized gesture
-          GestureType gesture = processCacheData();
-    
-          if (gesture != ARM_UNKNOWN) {
-            on_gesture(gesture);
-          }
-        }
-      }  
+
+  handleEvents(events);
+  updateTelemetry(now);
+}
+
+/**
+ * Handle the EMG data. Also handles syncing.
+ */
+void MyoIMUGestureController::handleEMGData(int8_t data[8]) {
+  unsigned long now = millis();
+  unsigned long start = micros();
+  uint8_t events = recognizer.handleEMGData(data, now);
+
+  if (telemetryEnabled()) {
+    addTelemetryTime(emg_timer, micros() - start);
+    //the envelope is smoothed over EMG_CACHE_SIZE packets, a fraction is enough
+    if (++emg_packets >= TELEMETRY_EMG_DIVIDER) {
+      emg_packets = 0;
+      sendEMGTelemetry(now, recognizer.getEMGSum(), recognizer.getSyncValue());
     }
-	
-	//when recording, save angles in gesture cache
-	if (!locked) {
-	  updateGestureCache(local[2][1], local[2][0], roll_angle);
-	}
   }
+
+  handleEvents(events);
+  updateTelemetry(now);
 }
 
 /**
- * Update the EMG cache. The EMG cache is used to smooth fluctuating values
+ * Send the periodic telemetry frames and the buffered data.
  */
-void MyoIMUGestureController::updateCache(int8_t* data) {
-  memmove(emgCache[1], emgCache[0], (EMG_CACHE_SIZE-1)* 8 *sizeof(int8_t));
-  memcpy (emgCache[0], data, 8 *sizeof(int8_t));
-  emgSum = 0;
-  for (int i=0; i<EMG_CACHE_SIZE; i++) {
-      for (int j=0; j<8; j++)
-        emgSum += abs(emgCache[i][j]);
+void MyoIMUGestureController::updateTelemetry(unsigned long now) {
+  if (!telemetryEnabled()) {
+    return;
   }
+
+  if (now - counter_time >= TELEMETRY_COUNTER_INTERVAL) {
+    counter_time = now;
+    sendCounterTelemetry(now, imu_timer, emg_timer);
+  }
+
+  flushTelemetry();
 }
 
 /**
- * Handle the EMG data. Also handles syncing.
+ * Trim idle samples before and after the movement from the recorded gestures.
  */
-void MyoIMUGestureController::handleEMGData(int8_t data[8]) {
-  //http://developerblog.myo.com/myocraft-emg-in-the-bluetooth-protocol/
+void MyoIMUGestureController::setMotionSource(uint8_t source) {
+  recognizer.setMotionSource(source);
+}
+
+/**
+ * Extrapolate the orientation of every IMU packet using the gyroscope.
+ */
+void MyoIMUGestureController::setPredictionTime(unsigned int milliseconds) {
+  recognizer.setPredictionTime(milliseconds);
+}
+
+/**
+ * Report the events of the recognizer to the user and the armband.
+ */
+void MyoIMUGestureController::handleEvents(uint8_t events) {
+
+  //text output would corrupt the telemetry stream
+  bool telemetry = telemetryEnabled();
+  unsigned long now = millis();
 
-  //store in EMG cache
-  updateCache(data);
+  if (events & RECOGNIZER_SYNC_START) {
+    //the user held a strong pose at startup: the loaded profile is discarded
+    if (calibration_stored) {
+      calibration_stored = false;
+      clearCalibration(calibration_address, armband_key);
+      //vibrate long to signalize start of syncing process
+      bridge->vibrate(3);
+    }
 
-  //start sync
-  if (timeConnected == 0) {
-    //prompt sync
-    timeConnected = millis();
-    #ifdef DEBUG_SERIAL
-    Serial.println(F("Syncing. Please perform a strong gesture to use for emg evaluation."));  
-    #endif
+    if (telemetry) {
+      sendSyncTelemetry(now, TELEMETRY_SYNC_START, recognizer.getSyncValue());
+    } else {
+      //prompt sync
+      #ifdef DEBUG_SERIAL
+      Serial.println(F("Syncing. Please perform a strong gesture to use for emg evaluation."));  
+      #endif
+    }
   }
 
-  //still syncing?
-  if (timeConnected + EMG_SYNC_TIME > millis()) {
+  //store the new reference value for the next start. A weak sync is not stored.
+  bool rejected = false;
+  if ((events & (RECOGNIZER_SYNC_DONE | RECOGNIZER_SYNC_UPDATE)) && (calibration_address >= 0)) {
+    calibration_stored = saveCalibration(calibration_address, armband_key, recognizer.getSyncValue());
+    rejected = !calibration_stored;
+  }
 
-    //when syncing, remember highest EMG value
-    if (emgSum > emgSync) emgSync = emgSum;  
-    
-  } else {
-    if (!isEMGSynced) {
-      isEMGSynced = true;
+  if (events & RECOGNIZER_SYNC_DONE) {
+    if (telemetry) {
+      sendSyncTelemetry(now, TELEMETRY_SYNC_DONE, recognizer.getSyncValue());
+    } else {
       #ifdef DEBUG_SERIAL
       Serial.println(F("Done."));
       #endif
-      //vibrate short to signalize end of syncing process
-      MyoIMUGestureController::bridge->vibrate(1);
-    }  
+    }
+    //vibrate short to signalize end of syncing process, medium if it could not be stored
+    bridge->vibrate(rejected ? 2 : 1);
+  }
+
+  if ((events & RECOGNIZER_SYNC_UPDATE) && telemetry) {
+    sendSyncTelemetry(now, TELEMETRY_SYNC_UPDATE, recognizer.getSyncValue());
+  }
+
+  if (rejected) {
+    if (telemetry) {
+      sendSyncTelemetry(now, TELEMETRY_SYNC_REJECTED, recognizer.getSyncValue());
+    } else {
+      #ifdef DEBUG_SERIAL
+      Serial.println(F("Sync too weak, not stored."));
+      #endif
+    }
+  }
+
+  //this runs inside the MyoBridge callbacks, the command is sent from update()
+  if (events & RECOGNIZER_IMU_CHANGE) {
+    imu_mode_pending = true;
+  }
+
+  if (events & RECOGNIZER_LOCK_CHANGE) {
+    if (telemetry) {
+      sendLockTelemetry(now, recognizer.isLocked());
+    }
+    on_lock_change(recognizer.isLocked());
+  }
+
+  if (events & RECOGNIZER_GESTURE) {
+    if (telemetry) {
+      sendGestureTelemetry(now, recognizer.getGesture(), recognizer.getGestureFeatures());
+    }
+    on_gesture(recognizer.getGesture());
   }
 }
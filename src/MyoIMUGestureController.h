@@ -14,17 +14,11 @@
 
 #include <MyoBridge.h>
 #include "include/gestureAnalysis.h"
+#include "include/gestureRecognizer.h"
+#include "include/calibration.h"
+#include "include/telemetry.h"
 #include "include/matrix.h"
 
-///Number of EMG values to cache
-#define EMG_CACHE_SIZE 10
-///time to perform sync gesture
-#define EMG_SYNC_TIME 3000
-///Lock toggle threshold
-#define LOCK_TOGGLE_THRESHOLD .5
-///time to wait after sync gesture
-#define AFTER_SYNC_WAIT 500
-
 /**
  * This class provides gesture detection functionality. The gestures are based on
  * arm rotation to work with persons where distinct muscle activity is hard to detect.
@@ -44,6 +38,8 @@ class MyoIMUGestureController {
      * as callbacks. The MyoBridge object is also used to send commands like vibrations.
      * Call after MyoBridge.connect()!
      * you can define DEBUG_SERIAL to print sync instructions to hardware serial.
+     * If calibration profiles are enabled (see enableCalibration()) and a profile is stored
+     * for the armband, syncing is skipped and the controller starts locked.
      * 
      * @param myoBridge The MyoBridge object to use.
      * @param onGesture Callback for gesture recognition
@@ -51,6 +47,74 @@ class MyoIMUGestureController {
      */
     static void begin(MyoBridge &myoBridge, void (*onGesture)(GestureType), void (*onLockChange)(bool));
 
+    /**
+     * Store the sync value in EEPROM as calibration profile and use it on the next start instead of syncing.
+     * Disabled by default. Call before begin(). Holding a strong pose for FORCE_SYNC_HOLD_TIME right after
+     * the start discards the profile and syncs again. Only supported on architectures with EEPROM
+     * (see CALIBRATION_EEPROM), elsewhere the controller always syncs.
+     *
+     * @param eepromAddress first of the CALIBRATION_EEPROM_SIZE EEPROM bytes the profiles may use.
+     * @param armbandKey CALIBRATION_KEY_SIZE bytes identifying the armband, e.g. its MAC address.
+     *                   NULL to use a single profile for all armbands.
+     */
+    static void enableCalibration(int eepromAddress, const uint8_t* armbandKey = NULL);
+
+    /**
+     * Refine the stored sync value with every lock/unlock gesture. The profile is
+     * updated in EEPROM only when the value has changed notably.
+     */
+    static void setResync(bool enable);
+
+    /**
+     * Delete the calibration profile of the armband. The next start will sync again.
+     */
+    static void forgetCalibration();
+
+    /**
+     * Is the current sync value stored as calibration profile? False while syncing, if profiles are
+     * disabled or not supported, and if the sync was too weak (below CALIBRATION_MIN_SYNC) to be stored.
+     * A weak sync is also signaled by a medium instead of a short vibration at the end of the sync.
+     */
+    static bool isCalibrationStored();
+
+    /**
+     * Suspend the IMU data stream of the armband while the controller is locked and idle.
+     * The stream is resumed as soon as the EMG values approach the lock/unlock threshold.
+     * Saves bandwidth on the serial link and processing time. Can be called before or after begin().
+     * The mode commands are sent from update(), which has to be called in loop().
+     */
+    static void setAdaptiveIMU(bool enable);
+
+    /**
+     * Send pending commands to the armband. Call in loop() after MyoBridge::update().
+     * Commands are not sent from the data callbacks, which run inside MyoBridge.
+     */
+    static void update();
+
+    /**
+     * Trim idle samples before and after the movement from the recorded gestures.
+     *
+     * @param source MOTION_SOURCE_GYRO (default) or MOTION_SOURCE_NONE to record all samples.
+     */
+    static void setMotionSource(uint8_t source);
+
+    /**
+     * Extrapolate the orientation of every IMU packet by the given time using the gyroscope,
+     * to compensate the delay of the data. 0 disables the prediction.
+     */
+    static void setPredictionTime(unsigned int milliseconds);
+
+    /**
+     * Send binary telemetry frames (see telemetry.h) over the given serial port: orientation
+     * samples, the EMG envelope, lock changes, sync events, the features of every recognized
+     * gesture and the processing time of the data handlers. Replaces the DEBUG_SERIAL text output.
+     * The frames are buffered and sent without blocking, frames that do not fit are dropped.
+     * Decode the stream with extras/HostTools/TelemetryDecoder.
+     *
+     * @param serial The initialized serial port, e.g. Serial after Serial.begin(115200). Native USB ports work as well.
+     */
+    static void enableTelemetry(Print &serial);
+
   private:
     
     /// Callback for gesture recognition
@@ -61,42 +125,46 @@ class MyoIMUGestureController {
     ///The MyoBridge object used
     static MyoBridge* bridge;
 
-    ///reference orientation. Set on unlock.
-    static Matrix33 inverseInitMatrix;
-    ///tell the IMU handle to save a new inverse init matrix
-    static bool refresh_init;
-    
-    ///the EMG data cache. used to smooth out EMG data
-    static int8_t emgCache[EMG_CACHE_SIZE][8];
-    ///sum of the absolute value of all EMG data stored in the cache.
-    static long emgSum;
-    ///maximum emgSum during sync time, used as reference.
-    static long emgSync;
-    ///Is EMG synced? (reference value stored)
-    static bool isEMGSynced;
-    ///Does the user currently do the lock/unlock pose? Used to toggle the lock state.
-    static bool lock_toggle; 
-    ///Is the device unlocked to store data?
-    static bool locked;
-    
-    /// the time in milliseconds passed since connection
-    static unsigned long timeConnected;
+    ///recognition state of the connected armband
+    static GestureRecognizer recognizer;
+
+    ///EEPROM address of the calibration profiles, -1 if disabled
+    static int calibration_address;
+    ///key of the calibration profile
+    static uint8_t armband_key[CALIBRATION_KEY_SIZE];
+    ///is the current sync value stored in the calibration profile?
+    static bool calibration_stored;
+
+    ///processing time of the data handlers for telemetry
+    static TelemetryTimer imu_timer, emg_timer;
+    ///time of the last TELEMETRY_COUNTERS frame
+    static unsigned long counter_time;
+    ///EMG packets since the last TELEMETRY_EMG frame
+    static uint8_t emg_packets;
+
+    ///the IMU mode has to be sent to the armband by update()
+    static bool imu_mode_pending;
      
     /**
      * handle the IMU data
      */
     static void handleIMUData(MyoIMUData& data);
     
-    /**
-     * Update the EMG cache. The EMG cache is used to smooth fluctuating values
-     */
-    static void updateCache(int8_t* data);
-    
     /**
      * Handle the EMG data. Also handles syncing.
      */
     static void handleEMGData(int8_t data[8]);
 
+    /**
+     * Report the events of the recognizer to the user and the armband.
+     */
+    static void handleEvents(uint8_t events);
+
+    /**
+     * Send the periodic telemetry frames and the buffered data.
+     */
+    static void updateTelemetry(unsigned long now);
+
 };
 
 #endif
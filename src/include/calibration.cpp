@@ -0,0 +1,172 @@
+/**
+ * @file   calibration.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Implementation file for the EMG calibration profiles stored in EEPROM.
+ *
+ * This library provides gesture detection functionality using almost exclusively the IMU data of the Myo Armband.
+ * The gestures are based on arm rotation to work with persons where distinct muscle activity is hard to detect.
+ * Muscle activity is only used for starting/ending the recording of a gesture. Uses the MyoBridge Arduino Library (https://github.com/vroland/MyoBridge).
+ */
+
+#include "calibration.h"
+
+#ifdef CALIBRATION_EEPROM
+
+#include <EEPROM.h>
+#include <stddef.h>
+
+/// key used if none is given
+static const uint8_t default_key[CALIBRATION_KEY_SIZE] = {0};
+
+//Dallas/Maxim CRC-8
+static uint8_t crc8(const uint8_t* data, uint8_t length) {
+  uint8_t crc = 0;
+  for (uint8_t i=0; i<length; i++) {
+    uint8_t byte_value = data[i];
+    for (uint8_t bit=0; bit<8; bit++) {
+      uint8_t mix = (crc ^ byte_value) & 0x01;
+      crc >>= 1;
+      if (mix) crc ^= 0x8C;
+      byte_value >>= 1;
+    }
+  }
+  return crc;
+}
+
+//make the profiles accessible. The flash emulation needs a buffer of sufficient size.
+static void openEEPROM(int address) {
+  #ifdef CALIBRATION_EEPROM_COMMIT
+  if (EEPROM.length() < address + CALIBRATION_EEPROM_SIZE) {
+    EEPROM.begin(address + CALIBRATION_EEPROM_SIZE);
+  }
+  #else
+  (void) address;
+  #endif
+}
+
+//write the changes to flash if the EEPROM is emulated
+static void commitEEPROM() {
+  #ifdef CALIBRATION_EEPROM_COMMIT
+  EEPROM.commit();
+  #endif
+}
+
+//EEPROM address of a profile slot
+static int slotAddress(int address, uint8_t slot) {
+  return address + slot * sizeof(CalibrationProfile);
+}
+
+//is the sync value usable?
+static bool syncPlausible(long emgSync) {
+  return (emgSync >= CALIBRATION_MIN_SYNC) && (emgSync <= CALIBRATION_MAX_SYNC);
+}
+
+//is the profile written completely?
+static bool profileValid(CalibrationProfile &profile) {
+  return (profile.magic == CALIBRATION_MAGIC)
+         && (profile.checksum == crc8((uint8_t*) &profile, offsetof(CalibrationProfile, checksum)))
+         && syncPlausible(profile.emgSync);
+}
+
+//find the slot of an armband, -1 if there is none
+static int findSlot(int address, const uint8_t* key) {
+  CalibrationProfile profile;
+  for (uint8_t slot=0; slot<CALIBRATION_SLOTS; slot++) {
+    EEPROM.get(slotAddress(address, slot), profile);
+    if (profileValid(profile) && (memcmp(profile.key, key, CALIBRATION_KEY_SIZE) == 0)) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Loads the sync value stored for an armband.
+ */
+bool loadCalibration(int address, const uint8_t* key, long &emgSync) {
+  if (key == NULL) key = default_key;
+  openEEPROM(address);
+
+  int slot = findSlot(address, key);
+  if (slot < 0) {
+    return false;
+  }
+
+  CalibrationProfile profile;
+  EEPROM.get(slotAddress(address, slot), profile);
+  emgSync = profile.emgSync;
+  return true;
+}
+
+/**
+ * Stores the sync value of an armband.
+ */
+bool saveCalibration(int address, const uint8_t* key, long emgSync) {
+  //a weak sync would be restored on every start
+  if (!syncPlausible(emgSync)) {
+    return false;
+  }
+
+  if (key == NULL) key = default_key;
+  openEEPROM(address);
+
+  int slot = findSlot(address, key);
+
+  //first free slot
+  CalibrationProfile profile;
+  for (uint8_t i=0; (slot < 0) && (i<CALIBRATION_SLOTS); i++) {
+    EEPROM.get(slotAddress(address, i), profile);
+    if (!profileValid(profile)) {
+      slot = i;
+    }
+  }
+
+  //all slots in use: overwrite the slot picked by the key
+  if (slot < 0) {
+    slot = crc8(key, CALIBRATION_KEY_SIZE) % CALIBRATION_SLOTS;
+  }
+
+  profile.magic = CALIBRATION_MAGIC;
+  memcpy(profile.key, key, CALIBRATION_KEY_SIZE);
+  profile.emgSync = emgSync;
+  profile.checksum = crc8((uint8_t*) &profile, offsetof(CalibrationProfile, checksum));
+
+  //put() only writes changed bytes
+  EEPROM.put(slotAddress(address, slot), profile);
+  commitEEPROM();
+  return true;
+}
+
+/**
+ * Invalidates the profile of an armband.
+ */
+void clearCalibration(int address, const uint8_t* key) {
+  if (key == NULL) key = default_key;
+  openEEPROM(address);
+
+  int slot = findSlot(address, key);
+  if (slot >= 0) {
+    //put() exists on all architectures and only writes if the byte changes
+    uint8_t invalid = 0;
+    EEPROM.put(slotAddress(address, slot), invalid);
+    commitEEPROM();
+  }
+}
+
+#else
+
+//no EEPROM: nothing is stored
+
+bool loadCalibration(int, const uint8_t*, long &) {
+  return false;
+}
+
+bool saveCalibration(int, const uint8_t*, long) {
+  return false;
+}
+
+void clearCalibration(int, const uint8_t*) {
+}
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file   calibration.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Header file describing the EMG calibration profiles stored in EEPROM.
+ *
+ * This library provides gesture detection functionality using almost exclusively the IMU data of the Myo Armband.
+ * The gestures are based on arm rotation to work with persons where distinct muscle activity is hard to detect.
+ * Muscle activity is only used for starting/ending the recording of a gesture. Uses the MyoBridge Arduino Library (https://github.com/vroland/MyoBridge).
+ */
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <Arduino.h>
+
+/// EEPROM is only available on these architectures, elsewhere no profile is stored or found.
+/// Define CALIBRATION_EEPROM for other boards with an EEPROM library of the same interface.
+#if defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_MEGAAVR) || defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_ESP32)
+#ifndef CALIBRATION_EEPROM
+#define CALIBRATION_EEPROM
+#endif
+#endif
+/// the EEPROM is emulated in flash and has to be committed
+#if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_ESP32)
+#define CALIBRATION_EEPROM_COMMIT
+#endif
+
+/// number of armbands a profile can be stored for
+#define CALIBRATION_SLOTS 4
+/// length of the key identifying an armband
+#define CALIBRATION_KEY_SIZE 6
+/// marks a written profile
+#define CALIBRATION_MAGIC 0x4D49
+/// smallest sync value that is stored: an average absolute EMG value of 5 per sample, twice the value of a relaxed arm
+#ifndef CALIBRATION_MIN_SYNC
+#define CALIBRATION_MIN_SYNC 400
+#endif
+/// largest possible sync value (EMG_CACHE_SIZE * 8 sensors * 128)
+#define CALIBRATION_MAX_SYNC 10240
+
+/**
+ * Calibration profile of one armband as stored in EEPROM.
+ */
+typedef struct CalibrationProfile {
+  /// CALIBRATION_MAGIC if the slot is in use
+  uint16_t magic;
+  /// key of the armband
+  uint8_t key[CALIBRATION_KEY_SIZE];
+  /// maximum EMG sum of the sync gesture
+  long emgSync;
+  /// CRC-8 of all fields above
+  uint8_t checksum;
+} CalibrationProfile;
+
+/// number of EEPROM bytes used for all profiles
+#define CALIBRATION_EEPROM_SIZE (CALIBRATION_SLOTS * sizeof(CalibrationProfile))
+
+/**
+ * Loads the sync value stored for an armband. Returns false if there is no valid profile.
+ *
+ * @param address first of the CALIBRATION_EEPROM_SIZE EEPROM bytes used for the profiles.
+ * @param key CALIBRATION_KEY_SIZE bytes identifying the armband, NULL for the default armband.
+ */
+bool loadCalibration(int address, const uint8_t* key, long &emgSync);
+
+/**
+ * Stores the sync value of an armband. Reuses the slot of the armband or picks a free one.
+ * Only changed bytes are written. Sync values outside of CALIBRATION_MIN_SYNC and CALIBRATION_MAX_SYNC
+ * are not stored, the function returns false then.
+ */
+bool saveCalibration(int address, const uint8_t* key, long emgSync);
+
+/**
+ * Invalidates the profile of an armband, so the next start syncs again.
+ */
+void clearCalibration(int address, const uint8_t* key);
+
+#endif
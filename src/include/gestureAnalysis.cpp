@@ -14,12 +14,9 @@
 /**
  * The gesture cache stores the x and y component of the pointing direction
  * while unlocked. When locked again, processCacheData tries to match a gesture
- * to the cached data.
+ * to the cached data. This one is used by the functions without cache parameter.
  */
-float gesture_cache[GESTURE_CACHE_SIZE];
-int gesture_cache_offset = 0;
-//cache the arm rotation to use later for gesture evaluation
-float gesture_roll_angle = 0;
+GestureCache default_gesture_cache = {{0}, 0, 0, 0, 0, 0};
 
 //Gesture strings
 const char* const gesture_strings[] = {
@@ -53,60 +50,170 @@ const char* gestureToString(GestureType type) {
  * Resets the gesture cache.
  */
 void resetGestureCache() {
-	gesture_cache_offset = 0;
-	gesture_roll_angle = 0;
+	resetGestureCache(default_gesture_cache);
+}
+
+void resetGestureCache(GestureCache &cache) {
+	cache.offset = 0;
+	cache.roll_angle = 0;
+	cache.motion = 0;
+	cache.active_end = 0;
+	cache.idle_samples = 0;
 }
 
 /**
  * The buffer will be filled at a rate of about 30 floats/second at maximum. This function resturns if it is full.
  */
 bool gestureBufferFull() {
-	return (gesture_cache_offset == GESTURE_CACHE_SIZE);
+	return gestureBufferFull(default_gesture_cache);
+}
+
+bool gestureBufferFull(GestureCache &cache) {
+	return (cache.offset == GESTURE_CACHE_SIZE) || (cache.idle_samples >= GESTURE_IDLE_TIMEOUT);
 }
 
 /**
  * Caches IMU data for gesture recognition
  */
 void updateGestureCache(float x, float y, float roll_angle) {
+  updateGestureCache(default_gesture_cache, x, y, roll_angle);
+}
 
-  if (gesture_cache_offset<GESTURE_CACHE_SIZE) {
-    gesture_cache[gesture_cache_offset]     = asin(clip(x, -.99999, .99999));  
-    gesture_cache[gesture_cache_offset + 1] = asin(clip(y, -.99999, .99999));  
-    gesture_cache_offset += 2;
+void updateGestureCache(GestureCache &cache, float x, float y, float roll_angle) {
+
+  if (cache.offset<GESTURE_CACHE_SIZE) {
+    cache.data[cache.offset]     = asin(clip(x, -.99999, .99999));  
+    cache.data[cache.offset + 1] = asin(clip(y, -.99999, .99999));  
+    cache.offset += 2;
   }
 
-  gesture_roll_angle = roll_angle;
+  cache.roll_angle = roll_angle;
+}
+
+void updateGestureCache(GestureCache &cache, float x, float y, float roll_angle, float motion) {
+
+  //trimming: only store moving samples
+  cache.motion += (motion - cache.motion) * GESTURE_MOTION_SMOOTHING;
+
+  if (cache.motion >= GESTURE_MOTION_THRESHOLD) {
+    updateGestureCache(cache, x, y, roll_angle);
+    cache.active_end = cache.offset;
+    cache.idle_samples = 0;
+  } else {
+    //inactivity: count the idle samples in a row
+    cache.idle_samples++;
+    //idle samples replace each other: only the latest one is kept after the movement
+    cache.offset = cache.active_end;
+    updateGestureCache(cache, x, y, roll_angle);
+  }
 }
 
 inline float getSqrPointDist(float x1, float y1, float x2, float y2) {
   return sqr(x1-x2)+sqr(y1-y2);
 }
 
+/**
+ * Cheap test if a gesture can be a circle at all.
+ */
+bool isCircleCandidate(int num_points, float ends_distance, float box_diagonal) {
+  return ((int)(num_points)/ GESTURE_CIRCLE_SAMPLES >= 1) && (ends_distance <= MAX_ENDS_DISCANCE)
+      && (box_diagonal * CIRCLE_BOX_TOLERANCE >= sqr(CIRCLE_MIN_DIAMETER));
+}
+
 /**
  * Processes the cached gesture data to recognize gestures.
  */
 GestureType processCacheData() {
+  return processCacheData(default_gesture_cache);
+}
+
+GestureType processCacheData(GestureCache &cache) {
+  return processCacheData(cache, NULL);
+}
+
+GestureType processCacheData(GestureCache &cache, GestureFeatures* features) {
 
+  float* gesture_cache = cache.data;
+  float gesture_roll_angle = cache.roll_angle;
   
   //store number of points and reset cache offset
-  int num_points = gesture_cache_offset / 2;
-  gesture_cache_offset = 0;
+  int num_points = cache.offset / 2;
+  cache.offset = 0;
+  cache.active_end = 0;
+  cache.idle_samples = 0;
+
+  if (features != NULL) {
+    memset(features, 0, sizeof(GestureFeatures));
+    features->num_points = num_points;
+    features->roll_angle = gesture_roll_angle;
+  }
+
+  //nothing recorded
+  if (num_points == 0) {
+    return ARM_UNKNOWN;
+  }
 
   /***************************************************
-   * Test for circular movement
+   * Gather some statistical data
    **************************************************/
+
+  float x_total = 0.;
+  float y_total = 0.;
+  float x_deviation = 0;
+  float y_deviation = 0;
+
+  //bounding box of all points
+  float box_x_min = gesture_cache[0];
+  float box_x_max = gesture_cache[0];
+  float box_y_min = gesture_cache[1];
+  float box_y_max = gesture_cache[1];
   
-  //list for storing diameters for all sample points
-  float sample_point_diameters[GESTURE_CIRCLE_SAMPLES] = {0};
-  
+  //get sum of all points and X/Y deviation
+  for (int i=0;i<num_points;i++) {
+    float x = gesture_cache[2 * i];
+    float y = gesture_cache[2 * i + 1];
+
+    x_total += x;
+    y_total += y;
+    
+    x_deviation += sqr(x);
+    y_deviation += sqr(y);
+
+    box_x_min = min(box_x_min, x);
+    box_x_max = max(box_x_max, x);
+    box_y_min = min(box_y_min, y);
+    box_y_max = max(box_y_max, y);
+  }
+
+  /***************************************************
+   * Test for circular movement
+   **************************************************/
+
+  //determine if the circle is nearly closed
+  float ends_distance = sqrt(getSqrPointDist(gesture_cache[0], gesture_cache[1],
+                             gesture_cache[2 * num_points - 2], gesture_cache[2 * num_points - 1]));
+
+  //no distance between two points is larger than the diagonal of the bounding box
+  float box_diagonal = getSqrPointDist(box_x_min, box_y_min, box_x_max, box_y_max);
+
+  if (features != NULL) {
+    features->x_mean = x_total / num_points;
+    features->y_mean = y_total / num_points;
+    features->ends_distance = ends_distance;
+    features->box_diagonal = box_diagonal;
+  }
+
   //pick sample points
   short index_offset = (int)(num_points)/ GESTURE_CIRCLE_SAMPLES;
 
-  float center_x = 0;
-  float center_y = 0;
-  
-  //enough points?
-  if (index_offset >= 1) {
+  //enough points? skip the expensive part if the ends are too far apart or the data is too small for a circle
+  if (isCircleCandidate(num_points, ends_distance, box_diagonal)) {
+
+    //list for storing squared diameters for all sample points
+    float sample_point_diameters[GESTURE_CIRCLE_SAMPLES] = {0};
+
+    float center_x = 0;
+    float center_y = 0;
 
     // find the greatest distance to another point (diameter) for all sample points
     for (int j=0;j<GESTURE_CIRCLE_SAMPLES;j++) {
@@ -119,9 +226,10 @@ GestureType processCacheData() {
       center_y += point_y;
       for (int i=0;i<num_points;i++) {
       
-        //get distance from sample point to current point
-        float dist = sqrt(getSqrPointDist(point_x, point_y,
-                     gesture_cache[2 * i], gesture_cache[2 * i + 1]));
+        //get squared distance from sample point to current point. 
+        //The root is taken of the maximum only, which gives the same result.
+        float dist = getSqrPointDist(point_x, point_y,
+                     gesture_cache[2 * i], gesture_cache[2 * i + 1]);
 
         // store maximum distance
         if (dist > sample_point_diameters[j]) {
@@ -145,7 +253,7 @@ GestureType processCacheData() {
     //get average circle radius 
     float average_radius = 0;
     for (int j=0;j<GESTURE_CIRCLE_SAMPLES;j++) {
-      average_radius +=sample_point_diameters[j];
+      average_radius += sqrt(sample_point_diameters[j]);
     }
     
     average_radius /= (float) GESTURE_CIRCLE_SAMPLES * 2.;
@@ -180,10 +288,11 @@ GestureType processCacheData() {
 
     //calculate deviation
     circular_deviation = sqrt(circular_deviation / (float) num_points);
-    
-    //determine if the circle is nearly closed
-    float ends_distance = sqrt(getSqrPointDist(gesture_cache[0], gesture_cache[1],
-                               gesture_cache[2 * num_points - 2], gesture_cache[2 * num_points - 1]));
+
+    if (features != NULL) {
+      features->circle_radius = average_radius;
+      features->circle_deviation = circular_deviation;
+    }
 
     //determine clockwise/counterclockwise
     bool clockwise = false;
@@ -208,24 +317,6 @@ GestureType processCacheData() {
     }
   }
 
-  /***************************************************
-   * Gather some statistical data
-   **************************************************/
-
-  float x_total = 0.;
-  float y_total = 0.;
-  float x_deviation = 0;
-  float y_deviation = 0;
-  
-  //get sum of all points and X/Y deviation
-  for (int i=0;i<num_points;i++) {
-    x_total += gesture_cache[2 * i];
-    y_total += gesture_cache[2 * i + 1];
-    
-    x_deviation += sqr(gesture_cache[2 * i]);
-    y_deviation += sqr(gesture_cache[2 * i + 1]);
-  }
-
   //calculate deviations
   x_deviation /= (float) num_points;
   y_deviation /= (float) num_points;
@@ -235,6 +326,11 @@ GestureType processCacheData() {
 
   //deviation relation
   float relation = x_deviation/y_deviation;
+
+  if (features != NULL) {
+    features->x_deviation = x_deviation;
+    features->y_deviation = y_deviation;
+  }
   
   /***************************************************
    * Test for arm rotation
@@ -255,6 +351,10 @@ GestureType processCacheData() {
    
   //determine the distance from (0,0)
   float distance = sqrt(getSqrPointDist(0, 0, gesture_cache[2 * num_points - 2], gesture_cache[2 * num_points - 1]));
+
+  if (features != NULL) {
+    features->distance = distance;
+  }
   
   //horizontal movement?
   if ((x_deviation > y_deviation) && (relation > 1./STRAIGHT_MAX_RELATION) && (distance >= STRAIGHT_MIN_DISTANCE)) {
@@ -19,6 +19,15 @@
 /// This has to be an even number!
 #define GESTURE_CACHE_SIZE 128
 
+/// motion trimming parameters
+
+/// minimum smoothed angular change per sample in rad for a sample to be part of the movement
+#define GESTURE_MOTION_THRESHOLD .02
+/// weight of a new sample in the smoothed angular change
+#define GESTURE_MOTION_SMOOTHING .5
+/// number of idle samples in a row after which the recording is considered inactive, see gestureBufferFull()
+#define GESTURE_IDLE_TIMEOUT (GESTURE_CACHE_SIZE / 2)
+
 /// Straight movement parameters
 
 /// maximum relation of X and Y standard deviation for straight movement
@@ -38,6 +47,8 @@
 #define CIRCLE_MAX_DEVIATION .3
 /// Maximum distance from start to end of the circle
 #define MAX_ENDS_DISCANCE .4
+/// Rounding tolerance of the bounding box test, which skips the circle test for small movements
+#define CIRCLE_BOX_TOLERANCE 1.001
 
 /// rotation movement parameters
 
@@ -59,6 +70,51 @@ typedef enum GestureType {
   ARM_UNKNOWN
 };
 
+/**
+ * Recorded data of one gesture. Every armband needs its own cache,
+ * the functions without a cache parameter work on a single global cache.
+ */
+typedef struct GestureCache {
+  /// x and y component of the pointing direction, stored alternately
+  float data[GESTURE_CACHE_SIZE];
+  /// number of floats stored in data
+  int offset;
+  /// the last arm rotation, used for gesture evaluation
+  float roll_angle;
+  /// smoothed angular change per sample, only used with motion trimming
+  float motion;
+  /// offset after the last moving sample, only used with motion trimming
+  int active_end;
+  /// number of idle samples since the last moving sample, only used with motion trimming
+  int idle_samples;
+} GestureCache;
+
+/**
+ * Intermediate values of the gesture evaluation, for diagnostics.
+ * Values of tests that were skipped are 0.
+ */
+typedef struct GestureFeatures {
+  /// number of evaluated points
+  int num_points;
+  /// average x and y of all points
+  float x_mean;
+  float y_mean;
+  /// X and Y deviation from (0, 0), Y corrected by Y_DEVIATION_CORRECTION
+  float x_deviation;
+  float y_deviation;
+  /// distance between start and end point
+  float ends_distance;
+  /// squared diagonal of the bounding box
+  float box_diagonal;
+  /// average radius and its standard deviation, if the circle test was performed
+  float circle_radius;
+  float circle_deviation;
+  /// distance of the end point from (0, 0), if the straight movement test was performed
+  float distance;
+  /// the last arm rotation
+  float roll_angle;
+} GestureFeatures;
+
 /**
  * Return the string equivalent of a GestureType constant.
  */
@@ -68,20 +124,44 @@ const char* gestureToString(GestureType type);
  * Caches IMU data for gesture recognition.
  */
 void updateGestureCache(float x, float y, float roll_angle);
+void updateGestureCache(GestureCache &cache, float x, float y, float roll_angle);
+
+/**
+ * Caches IMU data for gesture recognition and trims idle samples: only the movement is stored,
+ * together with the last idle sample before and after it.
+ *
+ * @param motion angular change since the previous sample in rad, from the gyroscope.
+ */
+void updateGestureCache(GestureCache &cache, float x, float y, float roll_angle, float motion);
 
 /**
  * Resets the gesture cache.
  */
 void resetGestureCache();
+void resetGestureCache(GestureCache &cache);
 
 /**
  * The buffer will be filled at a rate of about 30 floats/second at maximum. This function resturns if it is full.
+ * With motion trimming, it is also considered full after GESTURE_IDLE_TIMEOUT idle samples.
  */
 bool gestureBufferFull();
+bool gestureBufferFull(GestureCache &cache);
  
 /**
  * Processes the cached gesture data to recognize gestures.
  */
 GestureType processCacheData();
+GestureType processCacheData(GestureCache &cache);
+
+/**
+ * Processes the cached gesture data to recognize gestures and stores the intermediate values in features.
+ */
+GestureType processCacheData(GestureCache &cache, GestureFeatures* features);
+
+/**
+ * Cheap test if a gesture can be a circle at all: enough points, close ends (ends_distance) and a large enough
+ * bounding box (box_diagonal, squared). processCacheData() only performs the expensive circle test if this is true.
+ */
+bool isCircleCandidate(int num_points, float ends_distance, float box_diagonal);
 
 #endif
@@ -0,0 +1,378 @@
+/**
+ * @file   gestureRecognizer.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Implementation file for the per-armband recognition state.
+ *
+ * This library provides gesture detection functionality using almost exclusively the IMU data of the Myo Armband.
+ * The gestures are based on arm rotation to work with persons where distinct muscle activity is hard to detect.
+ * Muscle activity is only used for starting/ending the recording of a gesture. Uses the MyoBridge Arduino Library (https://github.com/vroland/MyoBridge).
+ */
+
+#include "gestureRecognizer.h"
+
+GestureRecognizer::GestureRecognizer() {
+  resetGestureCache(gestureCache);
+
+  memset(inverseInitMatrix, 0, sizeof(inverseInitMatrix));
+  refresh_init = true;
+
+  memset(emgCache, 0, sizeof(emgCache));
+  emgSum = 0;
+  emgSync = 0;
+  isEMGSynced = false;
+  syncLoaded = false;
+  forcePoseStart = 0;
+  resync = false;
+  posePeak = 0;
+  reportedSync = 0;
+  lock_toggle = true;
+  locked = false;
+  adaptiveIMU = false;
+  imuWanted = true;
+  imuNeededTime = 0;
+  imuSuspendTime = 0;
+  imuSuspendDelay = IMU_SUSPEND_DELAY;
+
+  motionSource = MOTION_SOURCE_GYRO;
+  lastIMUTime = 0;
+  memset(&features, 0, sizeof(features));
+  predictionTime = 0;
+
+  timeConnected = 0;
+  gesture = ARM_UNKNOWN;
+}
+
+///Is the recognizer locked (not recording)?
+bool GestureRecognizer::isLocked() {
+  return locked;
+}
+
+///The last recognized gesture.
+GestureType GestureRecognizer::getGesture() {
+  return gesture;
+}
+
+/**
+ * Use a stored sync value instead of syncing.
+ */
+void GestureRecognizer::loadSyncValue(long sync) {
+  emgSync = sync;
+  reportedSync = sync;
+  isEMGSynced = true;
+  syncLoaded = true;
+  //without sync phase, there is no initial recording to discard
+  locked = true;
+}
+
+///The reference EMG value of the lock/unlock gesture.
+long GestureRecognizer::getSyncValue() {
+  return emgSync;
+}
+
+/**
+ * Refine the sync value with the EMG peak of every lock/unlock pose.
+ */
+void GestureRecognizer::enableResync(bool enable) {
+  resync = enable;
+}
+
+/**
+ * Suspend the IMU stream while locked and idle.
+ */
+void GestureRecognizer::enableAdaptiveIMU(bool enable) {
+  adaptiveIMU = enable;
+  if (!enable) {
+    imuWanted = true;
+  }
+}
+
+///Is the IMU data stream needed?
+bool GestureRecognizer::wantsIMU() {
+  return imuWanted;
+}
+
+/**
+ * Trim idle samples before and after the movement from the recording.
+ */
+void GestureRecognizer::setMotionSource(uint8_t source) {
+  motionSource = source;
+}
+
+///The number of points the last recognized gesture was evaluated with.
+int GestureRecognizer::getGesturePoints() {
+  return features.num_points;
+}
+
+///The intermediate values of the last gesture evaluation.
+GestureFeatures& GestureRecognizer::getGestureFeatures() {
+  return features;
+}
+
+///The smoothed EMG value.
+long GestureRecognizer::getEMGSum() {
+  return emgSum;
+}
+
+/**
+ * Compensate the latency of the IMU data.
+ */
+void GestureRecognizer::setPredictionTime(unsigned int milliseconds) {
+  predictionTime = milliseconds;
+}
+
+/**
+ * Can the lock/unlock gesture be used?
+ */
+bool GestureRecognizer::isReady(unsigned long now) {
+  //enable locking/unlocking feature after a certain delay after sync
+  return isEMGSynced && (syncLoaded || (timeConnected + EMG_SYNC_TIME + AFTER_SYNC_WAIT < now));
+}
+
+/**
+ * handle the IMU data
+ */
+uint8_t GestureRecognizer::handleIMUData(MyoIMUData& data, unsigned long now) {
+
+  uint8_t events = 0;
+
+  //build matrix of the current absolute orientation
+  Matrix33 matrix = ZERO_MATRIX;
+  Matrix33 local = ZERO_MATRIX;
+
+  if (predictionTime > 0) {
+    predict_quaternion_to_matrix(matrix, data, predictionTime / 1000.);
+  } else {
+    unit_quaternion_to_matrix(matrix, (int16_t*)&data.orientation);
+  }
+
+  //save initial orientation matrix, is reset on unlock. Used for reference
+  if (refresh_init) {
+    inverse_matrix(matrix, inverseInitMatrix);
+    refresh_init = false;
+  }
+
+  multiply_matrix(matrix, inverseInitMatrix, local);
+
+  float roll_angle = asin(local[1][0]);
+
+  //angular change since the last packet, for motion trimming
+  float motion = 0;
+  if (motionSource == MOTION_SOURCE_GYRO) {
+    unsigned long interval = min(now - lastIMUTime, (unsigned long) MOTION_MAX_INTERVAL);
+    float rate = abs(data.gyroscope[0]) + abs(data.gyroscope[1]) + abs(data.gyroscope[2]);
+    motion = rate / MYOHW_GYROSCOPE_SCALE * (PI / 180.) * (interval / 1000.);
+  }
+  lastIMUTime = now;
+
+  if (isReady(now)) {
+
+    if ((float) emgSum/ (float) emgSync < LOCK_TOGGLE_THRESHOLD) {
+
+		//discard gesture if the buffer is full -> user is probably inactive or gesture incomplete
+		if ((!locked) && gestureBufferFull(gestureCache)) {
+
+			resetGestureCache(gestureCache);
+			// initiate re-locking
+			lock_toggle = false;
+			events |= RECOGNIZER_GESTURE_DISCARDED;
+		}
+
+		//toggle lock
+		if (!lock_toggle) {
+
+			lock_toggle = true;
+			locked = !locked;
+
+			//end of the pose: move the reference value towards the pose peak
+			if (resync && (posePeak > 0)) {
+				emgSync += (posePeak - emgSync) / RESYNC_WEIGHT;
+				posePeak = 0;
+
+				if (abs(emgSync - reportedSync) * RESYNC_REPORT_CHANGE > reportedSync) {
+					reportedSync = emgSync;
+					events |= RECOGNIZER_SYNC_UPDATE;
+				}
+			}
+
+			//end of unlocking gesture
+			if (!locked) {
+				resetGestureCache(gestureCache);
+			}
+
+			events |= RECOGNIZER_LOCK_CHANGE;
+		}
+
+    } else {
+      if (lock_toggle) {
+         refresh_init = true;
+         lock_toggle = false;
+
+         //begin of locking gesture
+         if (!locked) {
+
+          //get the recognized gesture
+          gesture = processCacheData(gestureCache, &features);
+
+          if (gesture != ARM_UNKNOWN) {
+            events |= RECOGNIZER_GESTURE;
+          }
+        }
+      }
+    }
+
+	//when recording, save angles in gesture cache
+	if (!locked) {
+	  if (motionSource == MOTION_SOURCE_NONE) {
+	    updateGestureCache(gestureCache, local[2][1], local[2][0], roll_angle);
+	  } else {
+	    updateGestureCache(gestureCache, local[2][1], local[2][0], roll_angle, motion);
+	  }
+	}
+  }
+
+  return events;
+}
+
+/**
+ * Update the EMG cache. The EMG cache is used to smooth fluctuating values
+ */
+void GestureRecognizer::updateCache(int8_t* data) {
+  memmove(emgCache[1], emgCache[0], (EMG_CACHE_SIZE-1)* 8 *sizeof(int8_t));
+  memcpy (emgCache[0], data, 8 *sizeof(int8_t));
+  emgSum = 0;
+  for (int i=0; i<EMG_CACHE_SIZE; i++) {
+      for (int j=0; j<8; j++)
+        emgSum += abs(emgCache[i][j]);
+  }
+}
+
+/**
+ * Handle the EMG data. Also handles syncing.
+ */
+uint8_t GestureRecognizer::handleEMGData(int8_t data[8], unsigned long now) {
+  //http://developerblog.myo.com/myocraft-emg-in-the-bluetooth-protocol/
+
+  uint8_t events = 0;
+
+  //store in EMG cache
+  updateCache(data);
+
+  //remember the peak of the current lock/unlock pose for refining the sync value
+  if (resync && isEMGSynced && !lock_toggle && (emgSum > posePeak)) {
+    posePeak = emgSum;
+  }
+
+  if (adaptiveIMU) {
+    events |= updateIMUDemand(now);
+  }
+
+  //stored sync value used, no sync necessary unless the user forces it
+  if (syncLoaded) {
+    if (timeConnected == 0) {
+      timeConnected = now;
+    }
+    if (!checkForcedSync(now)) {
+      return events;
+    }
+  }
+
+  //start sync
+  if (timeConnected == 0) {
+    timeConnected = now;
+    events |= RECOGNIZER_SYNC_START;
+  }
+
+  //still syncing?
+  if (timeConnected + EMG_SYNC_TIME > now) {
+
+    //when syncing, remember highest EMG value
+    if (emgSum > emgSync) emgSync = emgSum;
+
+  } else {
+    if (!isEMGSynced) {
+      isEMGSynced = true;
+      reportedSync = emgSync;
+      events |= RECOGNIZER_SYNC_DONE;
+    }
+  }
+
+  return events;
+}
+
+/**
+ * Discard a loaded sync value if the user holds a strong pose right after the start.
+ */
+bool GestureRecognizer::checkForcedSync(unsigned long now) {
+  if (emgSum < FORCE_SYNC_LEVEL) {
+    forcePoseStart = 0;
+    return false;
+  }
+
+  //only a pose starting right after the start counts
+  if (forcePoseStart == 0) {
+    if (now - timeConnected > FORCE_SYNC_WINDOW) {
+      return false;
+    }
+    forcePoseStart = now;
+  }
+
+  if (now - forcePoseStart < FORCE_SYNC_HOLD_TIME) {
+    return false;
+  }
+
+  //back to the state before the first packet, the sync starts with this packet
+  syncLoaded = false;
+  isEMGSynced = false;
+  emgSync = 0;
+  reportedSync = 0;
+  posePeak = 0;
+  timeConnected = 0;
+  forcePoseStart = 0;
+  lock_toggle = true;
+  locked = false;
+  refresh_init = true;
+  resetGestureCache(gestureCache);
+  return true;
+}
+
+/**
+ * Decide if the IMU stream is needed. Called for every EMG packet in adaptive mode.
+ */
+uint8_t GestureRecognizer::updateIMUDemand(unsigned long now) {
+
+  //keep the stream until the lock/unlock gesture can be used
+  if (!isReady(now)) {
+    return 0;
+  }
+
+  float level = (float) emgSum / (float) emgSync;
+
+  //the IMU handler may not be called while locked: detect the begin of the unlocking gesture here.
+  //the lock toggles at the end of the pose in the IMU handler, when the stream is running again.
+  if (locked && lock_toggle && (level >= LOCK_TOGGLE_THRESHOLD)) {
+    refresh_init = true;
+    lock_toggle = false;
+  }
+
+  //locked and no pose in sight?
+  if (!(locked && lock_toggle && (level < IMU_WAKE_THRESHOLD))) {
+    imuNeededTime = now;
+    if (!imuWanted) {
+      imuWanted = true;
+      //hysteresis: short idle periods between gestures should not switch the stream every time
+      if (now - imuSuspendTime < IMU_MIN_SUSPEND_TIME) {
+        imuSuspendDelay = min(2 * imuSuspendDelay, (unsigned int) IMU_MAX_SUSPEND_DELAY);
+      } else {
+        imuSuspendDelay = IMU_SUSPEND_DELAY;
+      }
+      return RECOGNIZER_IMU_CHANGE;
+    }
+  } else if (imuWanted && (now - imuNeededTime >= imuSuspendDelay)) {
+    imuWanted = false;
+    imuSuspendTime = now;
+    return RECOGNIZER_IMU_CHANGE;
+  }
+
+  return 0;
+}
@@ -0,0 +1,246 @@
+/**
+ * @file   gestureRecognizer.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Header file describing the per-armband recognition state.
+ *
+ * This library provides gesture detection functionality using almost exclusively the IMU data of the Myo Armband.
+ * The gestures are based on arm rotation to work with persons where distinct muscle activity is hard to detect.
+ * Muscle activity is only used for starting/ending the recording of a gesture. Uses the MyoBridge Arduino Library (https://github.com/vroland/MyoBridge).
+ */
+
+#ifndef GESTURERECOGNIZER_H
+#define GESTURERECOGNIZER_H
+
+#include <MyoBridge.h>
+#include "gestureAnalysis.h"
+#include "calibration.h"
+#include "matrix.h"
+
+///Number of EMG values to cache
+#define EMG_CACHE_SIZE 10
+///time to perform sync gesture
+#define EMG_SYNC_TIME 3000
+///Lock toggle threshold
+#define LOCK_TOGGLE_THRESHOLD .5
+///time to wait after sync gesture
+#define AFTER_SYNC_WAIT 500
+
+/// Events returned by the data handlers of GestureRecognizer as bit mask
+
+/// the sync procedure has started
+#define RECOGNIZER_SYNC_START 0x01
+/// the sync procedure is finished
+#define RECOGNIZER_SYNC_DONE 0x02
+/// the lock status has changed, see isLocked()
+#define RECOGNIZER_LOCK_CHANGE 0x04
+/// a gesture was recognized, see getGesture()
+#define RECOGNIZER_GESTURE 0x08
+/// the refined sync value differs notably from the last reported one, see getSyncValue()
+#define RECOGNIZER_SYNC_UPDATE 0x10
+/// the IMU data stream should be enabled or disabled, see wantsIMU()
+#define RECOGNIZER_IMU_CHANGE 0x20
+/// the recording was discarded because the buffer was full or the user was inactive
+#define RECOGNIZER_GESTURE_DISCARDED 0x40
+
+/// Sources of the angular change used to trim idle samples from a recording, see setMotionSource()
+
+/// record all samples
+#define MOTION_SOURCE_NONE 0
+/// angular velocity of the gyroscope, the default
+#define MOTION_SOURCE_GYRO 1
+/// maximum time in milliseconds the gyroscope data is integrated over, limits the effect of packet gaps
+#define MOTION_MAX_INTERVAL 40
+
+/// weight of the old sync value when refining it with the peak of a lock/unlock pose
+#define RESYNC_WEIGHT 8
+/// report a refined sync value if it differs by more than 1/RESYNC_REPORT_CHANGE from the last reported one
+#define RESYNC_REPORT_CHANGE 8
+
+/// a pose held this long in milliseconds right after start discards a loaded sync value and syncs again
+#define FORCE_SYNC_HOLD_TIME 2000
+/// the pose has to start within this time in milliseconds after the first EMG packet
+#define FORCE_SYNC_WINDOW 3000
+/// EMG value the pose has to exceed, independent of the loaded value which may be wrong. About twice a relaxed arm.
+#ifndef FORCE_SYNC_LEVEL
+#define FORCE_SYNC_LEVEL 400
+#endif
+
+/// relative EMG value that wakes the IMU stream, below LOCK_TOGGLE_THRESHOLD to resume it before the pose ends
+#define IMU_WAKE_THRESHOLD .3
+/// time in milliseconds the recognizer has to be locked and idle before the IMU stream is suspended
+#define IMU_SUSPEND_DELAY 500
+/// a suspension shorter than this time in milliseconds is mode churn: the suspend delay is doubled
+#define IMU_MIN_SUSPEND_TIME 500
+/// upper limit of the doubled suspend delay in milliseconds, a longer suspension resets it to IMU_SUSPEND_DELAY
+#define IMU_MAX_SUSPEND_DELAY 4000
+
+/**
+ * The complete recognition state of one armband: EMG smoothing, syncing, lock status
+ * and the gesture cache. It does not talk to the MyoBridge object or read the clock,
+ * which allows using one instance per armband, e.g. on a host.
+ */
+class GestureRecognizer {
+  public:
+
+    GestureRecognizer();
+
+    /**
+     * handle the IMU data
+     *
+     * @param data The IMU packet.
+     * @param now Time of the packet in milliseconds.
+     * @return bit mask of RECOGNIZER_* events.
+     */
+    uint8_t handleIMUData(MyoIMUData& data, unsigned long now);
+
+    /**
+     * Handle the EMG data. Also handles syncing.
+     *
+     * @param data The EMG values of the eight sensors.
+     * @param now Time of the packet in milliseconds.
+     * @return bit mask of RECOGNIZER_* events.
+     */
+    uint8_t handleEMGData(int8_t data[8], unsigned long now);
+
+    ///Is the recognizer locked (not recording)?
+    bool isLocked();
+
+    ///The last recognized gesture.
+    GestureType getGesture();
+
+    /**
+     * Use a stored sync value instead of syncing. The recognizer is ready at once
+     * and starts locked. Call before the first data packet.
+     * If the user holds a strong pose (FORCE_SYNC_LEVEL) for FORCE_SYNC_HOLD_TIME right after
+     * the start, the value is discarded and the recognizer syncs as usual, reporting RECOGNIZER_SYNC_START.
+     */
+    void loadSyncValue(long sync);
+
+    ///The reference EMG value of the lock/unlock gesture.
+    long getSyncValue();
+
+    /**
+     * Refine the sync value with the EMG peak of every lock/unlock pose. Reports
+     * RECOGNIZER_SYNC_UPDATE when the value has changed notably.
+     */
+    void enableResync(bool enable);
+
+    /**
+     * Suspend the IMU stream while locked and idle. The recognizer reports
+     * RECOGNIZER_IMU_CHANGE from handleEMGData() when the stream should be switched,
+     * the EMG stream has to stay enabled.
+     */
+    void enableAdaptiveIMU(bool enable);
+
+    ///Is the IMU data stream needed?
+    bool wantsIMU();
+
+    /**
+     * Trim idle samples before and after the movement from the recording, based on the
+     * given source of the angular change (MOTION_SOURCE_*, MOTION_SOURCE_GYRO by default).
+     * Only the movement is stored and evaluated, and the recording is discarded after
+     * GESTURE_IDLE_TIMEOUT idle samples instead of a full buffer. MOTION_SOURCE_NONE records all samples.
+     */
+    void setMotionSource(uint8_t source);
+
+    ///The number of points the last recognized gesture was evaluated with.
+    int getGesturePoints();
+
+    ///The intermediate values of the last gesture evaluation.
+    GestureFeatures& getGestureFeatures();
+
+    ///The smoothed EMG value, compare with getSyncValue().
+    long getEMGSum();
+
+    /**
+     * Compensate the latency of the IMU data: extrapolate the orientation of every packet
+     * by the given time using the gyroscope data of the same packet. A good value is the
+     * delay between measurement and processing, about one packet period plus the link delay.
+     *
+     * @param milliseconds prediction time, 0 to use the orientation as received.
+     */
+    void setPredictionTime(unsigned int milliseconds);
+
+  private:
+
+    ///the recorded data of the current gesture
+    GestureCache gestureCache;
+
+    ///reference orientation. Set on unlock.
+    Matrix33 inverseInitMatrix;
+    ///tell the IMU handle to save a new inverse init matrix
+    bool refresh_init;
+
+    ///the EMG data cache. used to smooth out EMG data
+    int8_t emgCache[EMG_CACHE_SIZE][8];
+    ///sum of the absolute value of all EMG data stored in the cache.
+    long emgSum;
+    ///maximum emgSum during sync time, used as reference.
+    long emgSync;
+    ///Is EMG synced? (reference value stored)
+    bool isEMGSynced;
+    ///Was the reference value loaded instead of syncing?
+    bool syncLoaded;
+    ///start of a strong pose that may force a sync, 0 if there is none
+    unsigned long forcePoseStart;
+    ///Refine the reference value during use?
+    bool resync;
+    ///highest emgSum of the current lock/unlock pose
+    long posePeak;
+    ///reference value last reported with RECOGNIZER_SYNC_UPDATE
+    long reportedSync;
+    ///Does the user currently do the lock/unlock pose? Used to toggle the lock state.
+    bool lock_toggle;
+    ///Is the device unlocked to store data?
+    bool locked;
+    ///Suspend the IMU stream when it is not needed?
+    bool adaptiveIMU;
+    ///Is the IMU stream needed?
+    bool imuWanted;
+    ///last time in milliseconds the IMU stream was needed
+    unsigned long imuNeededTime;
+    ///time in milliseconds the IMU stream was suspended
+    unsigned long imuSuspendTime;
+    ///current delay before suspending, grows after short suspensions
+    unsigned int imuSuspendDelay;
+
+    ///source of the angular change for motion trimming
+    uint8_t motionSource;
+    ///time of the previous IMU packet
+    unsigned long lastIMUTime;
+    ///intermediate values of the last gesture evaluation
+    GestureFeatures features;
+
+    ///time in milliseconds to extrapolate the orientation by
+    unsigned int predictionTime;
+
+    /// the time in milliseconds of the first EMG packet
+    unsigned long timeConnected;
+
+    ///the last recognized gesture
+    GestureType gesture;
+
+    /**
+     * Update the EMG cache. The EMG cache is used to smooth fluctuating values
+     */
+    void updateCache(int8_t* data);
+
+    /**
+     * Can the lock/unlock gesture be used?
+     */
+    bool isReady(unsigned long now);
+
+    /**
+     * Discard a loaded sync value if the user holds a strong pose right after the start.
+     * Returns true if the sync has to start.
+     */
+    bool checkForcedSync(unsigned long now);
+
+    /**
+     * Decide if the IMU stream is needed. Called for every EMG packet in adaptive mode.
+     */
+    uint8_t updateIMUDemand(unsigned long now);
+};
+
+#endif
@@ -26,6 +26,9 @@ inline float clip(float n, float lower, float upper) {
   return max(lower, min(n, upper));
 }
 
+//convert a unit quaternion of floats to a 3x3 matrix
+void float_quaternion_to_matrix(Matrix33 &matrix, float x, float y, float z, float w);
+
 //squared distance of two points represented as vectors
 float sqr_dist(float* v1, float* v2) {
   return sqr(v1[0]-v2[0])+sqr(v1[1]-v2[1])+sqr(v1[2]-v2[2]);
@@ -121,11 +124,48 @@ void inverse_matrix(Matrix33 in, Matrix33 &out) {
 void unit_quaternion_to_matrix(Matrix33 &matrix, int16_t* quat) {
 
   //convert the raw data in unit quaternion of floats. 
+  //MyoIMUData::orientation is w, x, y, z in memory, the gesture thresholds are based on reading it as x, y, z, w.
   float x = clip((float)quat[0] / (MYOHW_ORIENTATION_SCALE), -.999999, .999999); 
   float y = clip((float)quat[1] / (MYOHW_ORIENTATION_SCALE), -.999999, .999999); 
   float z = clip((float)quat[2] / (MYOHW_ORIENTATION_SCALE), -.999999, .999999); 
   float w = clip((float)quat[3] / (MYOHW_ORIENTATION_SCALE), -.999999, .999999); 
   
+  float_quaternion_to_matrix(matrix, x, y, z, w);
+}
+
+/**
+ * convert a myo unit quaternion to a 3x3 matrix, after rotating it by the angular velocity
+ * of the gyroscope for the given time.
+ */
+void predict_quaternion_to_matrix(Matrix33 &matrix, MyoIMUData &data, float seconds) {
+
+  float w = (float)data.orientation.w / (MYOHW_ORIENTATION_SCALE);
+  float x = (float)data.orientation.x / (MYOHW_ORIENTATION_SCALE);
+  float y = (float)data.orientation.y / (MYOHW_ORIENTATION_SCALE);
+  float z = (float)data.orientation.z / (MYOHW_ORIENTATION_SCALE);
+
+  //half rotation angle around every axis, the gyroscope measures in the sensor frame
+  float factor = seconds * (PI / 180.) / (2. * MYOHW_GYROSCOPE_SCALE);
+  float hx = data.gyroscope[0] * factor;
+  float hy = data.gyroscope[1] * factor;
+  float hz = data.gyroscope[2] * factor;
+
+  //rotate by the small angle quaternion (1, hx, hy, hz), multiplied from the right
+  float pw = w - x*hx - y*hy - z*hz;
+  float px = x + w*hx + y*hz - z*hy;
+  float py = y + w*hy - x*hz + z*hx;
+  float pz = z + w*hz + x*hy - y*hx;
+
+  //normalize, the small angle quaternion is not a unit quaternion
+  float norm = 1. / sqrt(sqr(pw) + sqr(px) + sqr(py) + sqr(pz));
+
+  //same matrix as unit_quaternion_to_matrix(): it reads the fields in memory order w, x, y, z as x, y, z, w
+  float_quaternion_to_matrix(matrix, pw * norm, px * norm, py * norm, pz * norm);
+}
+
+//convert a unit quaternion of floats to a 3x3 matrix
+void float_quaternion_to_matrix(Matrix33 &matrix, float x, float y, float z, float w) {
+
   matrix[0][0] = 1-2*y*y-2*z*z;
   matrix[0][1] = 2*x*y-2*w*z;
   matrix[0][2] = 2*x*z+2*w*y;
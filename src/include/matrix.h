@@ -13,6 +13,7 @@
 #define MATRIX_H
 
 #include <Arduino.h>
+#include <MyoBridge.h>
 
 /// 3x3 array of zeros, used for matrix initialization.
 #define ZERO_MATRIX {{0, 0, 0},{0, 0, 0},{0, 0, 0}}
@@ -55,4 +56,10 @@ void inverse_matrix(Matrix33 in, Matrix33 &out);
  */
 void unit_quaternion_to_matrix(Matrix33 &matrix, int16_t* quat);
 
+/**
+ * convert a myo unit quaternion to a 3x3 matrix, after rotating it by the angular velocity
+ * of the gyroscope for the given time. Used to predict the current orientation from the last packet.
+ */
+void predict_quaternion_to_matrix(Matrix33 &matrix, MyoIMUData &data, float seconds);
+
 #endif //MATRIX_H
@@ -0,0 +1,290 @@
+/**
+ * @file   telemetry.cpp
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Implementation file for the binary telemetry stream.
+ *
+ * This library provides gesture detection functionality using almost exclusively the IMU data of the Myo Armband.
+ * The gestures are based on arm rotation to work with persons where distinct muscle activity is hard to detect.
+ * Muscle activity is only used for starting/ending the recording of a gesture. Uses the MyoBridge Arduino Library (https://github.com/vroland/MyoBridge).
+ */
+
+#include "telemetry.h"
+
+/// serial port used for telemetry, NULL if disabled
+Print* telemetry_serial = NULL;
+
+/// encoded frames waiting for transmission
+uint8_t telemetry_buffer[TELEMETRY_BUFFER_SIZE];
+/// position of the next byte to send
+uint16_t telemetry_head = 0;
+/// number of bytes in the buffer
+uint16_t telemetry_used = 0;
+/// frames dropped because the buffer was full
+uint16_t telemetry_dropped = 0;
+
+/**
+ * Start sending telemetry over the given serial port.
+ */
+void beginTelemetry(Print &serial) {
+  telemetry_serial = &serial;
+  telemetry_head = 0;
+  telemetry_used = 0;
+  telemetry_dropped = 0;
+}
+
+/**
+ * Stop sending telemetry, after writing what fits into the transmit buffer.
+ */
+void endTelemetry() {
+  flushTelemetry();
+  telemetry_serial = NULL;
+  telemetry_used = 0;
+}
+
+///Is telemetry enabled?
+bool telemetryEnabled() {
+  return telemetry_serial != NULL;
+}
+
+///Number of frames dropped because the ring buffer was full.
+uint16_t telemetryDroppedFrames() {
+  return telemetry_dropped;
+}
+
+///Number of bytes in the ring buffer not written to the serial port yet.
+uint16_t telemetryBufferedBytes() {
+  return telemetry_used;
+}
+
+/**
+ * Writes as much of the buffered data to the serial port as fits into its transmit buffer.
+ */
+void flushTelemetry() {
+  if (telemetry_serial == NULL) {
+    return;
+  }
+
+  int space = telemetry_serial->availableForWrite();
+  while ((space > 0) && (telemetry_used > 0)) {
+    telemetry_serial->write(telemetry_buffer[telemetry_head]);
+    telemetry_head = (telemetry_head + 1) % TELEMETRY_BUFFER_SIZE;
+    telemetry_used--;
+    space--;
+  }
+}
+
+/**
+ * Assemble and send a frame, only used by the frame types below.
+ */
+static void addToFrame(TelemetryFrame &frame, const void* value, uint8_t size) {
+  //the frame types are defined to fit, just make sure not to overflow
+  if (frame.length + size > TELEMETRY_MAX_FRAME) {
+    return;
+  }
+  memcpy(frame.data + frame.length, value, size);
+  frame.length += size;
+}
+
+static void startFrame(TelemetryFrame &frame, uint8_t type, unsigned long time) {
+  frame.length = 0;
+  addToFrame(frame, &type, sizeof(type));
+
+  uint32_t time32 = time;
+  addToFrame(frame, &time32, sizeof(time32));
+}
+
+static bool sendFrame(TelemetryFrame &frame) {
+  if (telemetry_serial == NULL) {
+    return false;
+  }
+
+  //frame with CRC
+  uint8_t raw[TELEMETRY_MAX_FRAME + 2];
+  memcpy(raw, frame.data, frame.length);
+  uint16_t crc = telemetryCRC(frame.data, frame.length);
+  raw[frame.length] = crc & 0xFF;
+  raw[frame.length + 1] = crc >> 8;
+
+  uint8_t encoded[TELEMETRY_MAX_FRAME + 4];
+  uint8_t length = cobsEncode(raw, frame.length + 2, encoded);
+
+  //drop the complete frame if it does not fit, a partial frame would be useless
+  if (telemetry_used + length + 1 > TELEMETRY_BUFFER_SIZE) {
+    telemetry_dropped++;
+    return false;
+  }
+
+  uint16_t tail = (telemetry_head + telemetry_used) % TELEMETRY_BUFFER_SIZE;
+  for (uint8_t i=0; i<length; i++) {
+    telemetry_buffer[tail] = encoded[i];
+    tail = (tail + 1) % TELEMETRY_BUFFER_SIZE;
+  }
+  telemetry_buffer[tail] = 0;
+  telemetry_used += length + 1;
+
+  flushTelemetry();
+  return true;
+}
+
+/**
+ * Frames of the individual types.
+ */
+void sendOrientationTelemetry(unsigned long time, MyoIMUData &data, bool locked) {
+  TelemetryFrame frame;
+  startFrame(frame, TELEMETRY_ORIENTATION, time);
+  addToFrame(frame, &data.orientation.w, sizeof(int16_t));
+  addToFrame(frame, &data.orientation.x, sizeof(int16_t));
+  addToFrame(frame, &data.orientation.y, sizeof(int16_t));
+  addToFrame(frame, &data.orientation.z, sizeof(int16_t));
+  addToFrame(frame, data.gyroscope, 3 * sizeof(int16_t));
+  uint8_t lock_state = locked;
+  addToFrame(frame, &lock_state, sizeof(lock_state));
+  sendFrame(frame);
+}
+
+void sendEMGTelemetry(unsigned long time, long emgSum, long emgSync) {
+  TelemetryFrame frame;
+  startFrame(frame, TELEMETRY_EMG, time);
+  uint16_t sum = min(emgSum, 0xFFFFL);
+  uint16_t sync = min(emgSync, 0xFFFFL);
+  addToFrame(frame, &sum, sizeof(sum));
+  addToFrame(frame, &sync, sizeof(sync));
+  sendFrame(frame);
+}
+
+void sendLockTelemetry(unsigned long time, bool locked) {
+  TelemetryFrame frame;
+  startFrame(frame, TELEMETRY_LOCK, time);
+  uint8_t lock_state = locked;
+  addToFrame(frame, &lock_state, sizeof(lock_state));
+  sendFrame(frame);
+}
+
+void sendGestureTelemetry(unsigned long time, GestureType gesture, GestureFeatures &features) {
+  TelemetryFrame frame;
+  startFrame(frame, TELEMETRY_GESTURE, time);
+  uint8_t type = gesture;
+  uint16_t num_points = features.num_points;
+  addToFrame(frame, &type, sizeof(type));
+  addToFrame(frame, &num_points, sizeof(num_points));
+  addToFrame(frame, &features.x_mean, sizeof(float));
+  addToFrame(frame, &features.y_mean, sizeof(float));
+  addToFrame(frame, &features.x_deviation, sizeof(float));
+  addToFrame(frame, &features.y_deviation, sizeof(float));
+  addToFrame(frame, &features.ends_distance, sizeof(float));
+  addToFrame(frame, &features.box_diagonal, sizeof(float));
+  addToFrame(frame, &features.circle_radius, sizeof(float));
+  addToFrame(frame, &features.circle_deviation, sizeof(float));
+  addToFrame(frame, &features.distance, sizeof(float));
+  addToFrame(frame, &features.roll_angle, sizeof(float));
+  sendFrame(frame);
+}
+
+void sendSyncTelemetry(unsigned long time, uint8_t event, long emgSync) {
+  TelemetryFrame frame;
+  startFrame(frame, TELEMETRY_SYNC, time);
+  int32_t sync = emgSync;
+  addToFrame(frame, &event, sizeof(event));
+  addToFrame(frame, &sync, sizeof(sync));
+  sendFrame(frame);
+}
+
+//count, average and maximum of a timer
+static void addTimerToFrame(TelemetryFrame &frame, TelemetryTimer &timer) {
+  uint16_t average = (timer.count > 0) ? timer.total / timer.count : 0;
+  addToFrame(frame, &timer.count, sizeof(timer.count));
+  addToFrame(frame, &average, sizeof(average));
+  addToFrame(frame, &timer.max, sizeof(timer.max));
+  memset(&timer, 0, sizeof(timer));
+}
+
+/**
+ * Sends the statistics of both handlers and resets them.
+ */
+void sendCounterTelemetry(unsigned long time, TelemetryTimer &imu, TelemetryTimer &emg) {
+  TelemetryFrame frame;
+  startFrame(frame, TELEMETRY_COUNTERS, time);
+  addTimerToFrame(frame, imu);
+  addTimerToFrame(frame, emg);
+  addToFrame(frame, &telemetry_dropped, sizeof(telemetry_dropped));
+  sendFrame(frame);
+}
+
+/**
+ * Add the duration of a handler call to the statistics.
+ */
+void addTelemetryTime(TelemetryTimer &timer, unsigned long duration) {
+  uint16_t clipped = min(duration, 0xFFFFUL);
+  timer.count++;
+  timer.total += clipped;
+  timer.max = max(timer.max, clipped);
+}
+
+/**
+ * CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF).
+ */
+uint16_t telemetryCRC(const uint8_t* data, uint8_t length) {
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i=0; i<length; i++) {
+    crc ^= (uint16_t) data[i] << 8;
+    for (uint8_t bit=0; bit<8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**
+ * COBS encoding: removes all zero bytes.
+ */
+uint8_t cobsEncode(const uint8_t* in, uint8_t length, uint8_t* out) {
+  uint8_t code_index = 0;
+  uint8_t out_index = 1;
+  uint8_t code = 1;
+
+  for (uint8_t i=0; i<length; i++) {
+    if (in[i] == 0) {
+      out[code_index] = code;
+      code = 1;
+      code_index = out_index++;
+    } else {
+      out[out_index++] = in[i];
+      code++;
+      //maximum block length reached
+      if (code == 0xFF) {
+        out[code_index] = code;
+        code = 1;
+        code_index = out_index++;
+      }
+    }
+  }
+  out[code_index] = code;
+  return out_index;
+}
+
+/**
+ * COBS decoding, without the terminating zero byte.
+ */
+int cobsDecode(const uint8_t* in, int length, uint8_t* out) {
+  int out_index = 0;
+  int i = 0;
+
+  while (i < length) {
+    uint8_t code = in[i++];
+    if (code == 0) {
+      return -1;
+    }
+    for (uint8_t j=1; j<code; j++) {
+      if (i >= length) {
+        return -1;
+      }
+      out[out_index++] = in[i++];
+    }
+    //every block but the last and the full ones ends with a zero
+    if ((code < 0xFF) && (i < length)) {
+      out[out_index++] = 0;
+    }
+  }
+  return out_index;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file   telemetry.h
+ * @author Valentin Roland (webmaster at vroland.de)
+ * @date   September-October 2015
+ * @brief  Header file describing the binary telemetry stream.
+ *
+ * This library provides gesture detection functionality using almost exclusively the IMU data of the Myo Armband.
+ * The gestures are based on arm rotation to work with persons where distinct muscle activity is hard to detect.
+ * Muscle activity is only used for starting/ending the recording of a gesture. Uses the MyoBridge Arduino Library (https://github.com/vroland/MyoBridge).
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include <MyoBridge.h>
+#include "gestureAnalysis.h"
+
+/**
+ * Every frame consists of a type byte, the payload and a CRC-16/CCITT of both (little endian).
+ * The frame is COBS encoded and terminated by a zero byte. All values of the payload
+ * are stored little endian, floats as IEEE 754 single precision. Every payload starts with
+ * the time in milliseconds (uint32).
+ */
+
+/// size of the transmit ring buffer in bytes
+#ifndef TELEMETRY_BUFFER_SIZE
+#define TELEMETRY_BUFFER_SIZE 128
+#endif
+/// maximum size of type and payload of a frame in bytes
+#define TELEMETRY_MAX_FRAME 56
+/// send a TELEMETRY_EMG frame for every n-th EMG packet
+#define TELEMETRY_EMG_DIVIDER 4
+/// time in milliseconds between two TELEMETRY_COUNTERS frames
+#define TELEMETRY_COUNTER_INTERVAL 1000
+
+/// Frame types
+
+/// quaternion w, x, y, z and gyroscope x, y, z as received (int16), lock status (uint8)
+#define TELEMETRY_ORIENTATION 1
+/// smoothed EMG value and sync value (uint16)
+#define TELEMETRY_EMG 2
+/// new lock status (uint8)
+#define TELEMETRY_LOCK 3
+/// recognized GestureType (uint8), number of points (uint16), the other GestureFeatures (float)
+#define TELEMETRY_GESTURE 4
+/// IMU and EMG handler: packets (uint16), average and maximum duration in us (uint16); dropped frames (uint16)
+#define TELEMETRY_COUNTERS 5
+/// sync event (uint8, TELEMETRY_SYNC_*) and sync value (int32)
+#define TELEMETRY_SYNC 6
+
+/// Sync events
+
+#define TELEMETRY_SYNC_START 0
+#define TELEMETRY_SYNC_DONE 1
+#define TELEMETRY_SYNC_UPDATE 2
+#define TELEMETRY_SYNC_LOADED 3
+/// the sync value was not stored in the calibration profile, it is outside of CALIBRATION_MIN_SYNC and CALIBRATION_MAX_SYNC
+#define TELEMETRY_SYNC_REJECTED 4
+
+/**
+ * A frame being assembled, before CRC and encoding.
+ */
+typedef struct TelemetryFrame {
+  /// type and payload
+  uint8_t data[TELEMETRY_MAX_FRAME];
+  /// number of bytes in data
+  uint8_t length;
+} TelemetryFrame;
+
+/**
+ * Duration statistics of a data handler.
+ */
+typedef struct TelemetryTimer {
+  /// number of calls
+  uint16_t count;
+  /// sum of all durations in microseconds
+  uint32_t total;
+  /// longest duration in microseconds
+  uint16_t max;
+} TelemetryTimer;
+
+/**
+ * Start sending telemetry over the given serial port. The port has to be initialized already.
+ * Any Print works that reports its free transmit buffer with availableForWrite(), e.g. a
+ * HardwareSerial or the native USB Serial.
+ */
+void beginTelemetry(Print &serial);
+
+/**
+ * Stop sending telemetry. Buffered frames are written as far as the transmit buffer of the serial port
+ * takes them, the rest is discarded. Call flushTelemetry() until telemetryBufferedBytes() is 0 before
+ * to send all of them.
+ */
+void endTelemetry();
+
+///Is telemetry enabled?
+bool telemetryEnabled();
+
+/**
+ * Writes as much of the buffered data to the serial port as fits into its transmit buffer.
+ * Never blocks.
+ */
+void flushTelemetry();
+
+///Number of frames dropped because the ring buffer was full.
+uint16_t telemetryDroppedFrames();
+
+///Number of bytes in the ring buffer not written to the serial port yet.
+uint16_t telemetryBufferedBytes();
+
+/**
+ * Frames of the individual types. Frames that do not fit into the ring buffer are dropped completely.
+ */
+void sendOrientationTelemetry(unsigned long time, MyoIMUData &data, bool locked);
+void sendEMGTelemetry(unsigned long time, long emgSum, long emgSync);
+void sendLockTelemetry(unsigned long time, bool locked);
+void sendGestureTelemetry(unsigned long time, GestureType gesture, GestureFeatures &features);
+void sendSyncTelemetry(unsigned long time, uint8_t event, long emgSync);
+
+/**
+ * Sends the statistics of both handlers and resets them.
+ */
+void sendCounterTelemetry(unsigned long time, TelemetryTimer &imu, TelemetryTimer &emg);
+
+/**
+ * Add the duration of a handler call to the statistics.
+ */
+void addTelemetryTime(TelemetryTimer &timer, unsigned long duration);
+
+/**
+ * CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF).
+ */
+uint16_t telemetryCRC(const uint8_t* data, uint8_t length);
+
+/**
+ * COBS encoding: removes all zero bytes. out needs space for length + length/254 + 1 bytes.
+ * Returns the encoded length.
+ */
+uint8_t cobsEncode(const uint8_t* in, uint8_t length, uint8_t* out);
+
+/**
+ * COBS decoding, without the terminating zero byte. Returns the decoded length or -1 if the data is invalid.
+ */
+int cobsDecode(const uint8_t* in, int length, uint8_t* out);
+
+#endif